@@ -1,12 +1,36 @@
 // Copyright (c) 2020, Ben Wiederhake <BenWiederhake.GitHub@gmx.de>
 
 #include <assert.h>
-#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 
-typedef char assert_size_t_is_int[sizeof(size_t) == 4 ? 1 : -1];
+#define ALWAYS_INLINE inline __attribute__((always_inline))
 
 #if 1
 static const char* TEXT_ERROR = "\x1b[01;35m";
@@ -123,10 +147,95 @@ double old_strtod(const char* str, char** endptr)
     return is_negative ? -value : value;
 }
 
-void strtons(const char* str, char** endptr) {
+// Where the input ends. NUL-terminated strings don't know that in advance,
+// and rely on the NUL byte instead. Explicit ranges behave exactly as if
+// there was a NUL byte at `end`, but never actually read it.
+template<bool bounded>
+struct Bounds {
+    const char* end;
+
+    char at(const char* ptr, int offset = 0) const {
+        if (bounded && offset >= end - ptr)
+            return '\0';
+        return ptr[offset];
+    }
+
+    // Unlike `at`, this doesn't mistake a NUL byte inside a range for the end.
+    bool at_end(const char* ptr) const {
+        if (bounded)
+            return ptr >= end;
+        return *ptr == '\0';
+    }
+
+    bool can_load_eight_bytes(const char* ptr) const {
+        if (bounded)
+            return end - ptr >= 8;
+        // We don't know where the string ends, so we might read past the NUL byte.
+        // That's harmless as long as we stay within the same page, which is the
+        // same trick that every optimized strlen uses.
+        const uintptr_t page_size = 4096;
+        return (reinterpret_cast<uintptr_t>(ptr) & (page_size - 1)) <= page_size - 8;
+    }
+};
+
+typedef Bounds<false> NulTerminated;
+typedef Bounds<true> Range;
+
+// Character classification without <ctype.h>: That depends on the global
+// locale (which is slow, and not something a parser should care about), and
+// is undefined for negative chars. Instead, each character costs one load.
+// Digits in any base up to 36 map to their value. Everything else maps to
+// something that is at least as large as any base.
+constexpr uint8_t CHAR_CLASS_SPACE = 0x40;
+// The rest of what can appear inside a number: '+', '-' and '.'.
+constexpr uint8_t CHAR_CLASS_PUNCT = 0x41;
+constexpr uint8_t CHAR_CLASS_OTHER = 0xFF;
+
+struct CharClassTable {
+    uint8_t entries[256];
+};
+
+constexpr CharClassTable generate_char_class_table() {
+    CharClassTable table {};
+    for (int ch = 0; ch < 256; ++ch) {
+        uint8_t entry = CHAR_CLASS_OTHER;
+        if ('0' <= ch && ch <= '9')
+            entry = ch - '0';
+        else if ('a' <= ch && ch <= 'z')
+            entry = ch - ('a' - 10);
+        else if ('A' <= ch && ch <= 'Z')
+            entry = ch - ('A' - 10);
+        // Exactly what isspace() considers whitespace in the "C" locale.
+        else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r')
+            entry = CHAR_CLASS_SPACE;
+        else if (ch == '+' || ch == '-' || ch == '.')
+            entry = CHAR_CLASS_PUNCT;
+        table.entries[ch] = entry;
+    }
+    return table;
+}
+
+static constexpr CharClassTable CHAR_CLASSES = generate_char_class_table();
+
+ALWAYS_INLINE uint8_t char_class(char ch) {
+    return CHAR_CLASSES.entries[static_cast<unsigned char>(ch)];
+}
+
+ALWAYS_INLINE bool is_space(char ch) {
+    return char_class(ch) == CHAR_CLASS_SPACE;
+}
+
+// Returns -1 if `ch` is not a digit in `base`.
+ALWAYS_INLINE int digit_value(char ch, int base) {
+    const int digit = char_class(ch);
+    return digit < base ? digit : -1;
+}
+
+template<bool bounded>
+void strtons(const char* str, Bounds<bounded> bounds, char** endptr) {
     assert(endptr);
     char* ptr = const_cast<char*>(str);
-    while (isspace(*ptr)) {
+    while (is_space(bounds.at(ptr))) {
         ptr += 1;
     }
     *endptr = ptr;
@@ -137,12 +246,14 @@ enum Sign {
     Positive,
 };
 
-Sign strtosign(const char* str, char** endptr) {
+template<bool bounded>
+Sign strtosign(const char* str, Bounds<bounded> bounds, char** endptr) {
     assert(endptr);
-    if (*str == '+') {
+    const char ch = bounds.at(str);
+    if (ch == '+') {
         *endptr = const_cast<char*>(str + 1);
         return Sign::Positive;
-    } else if (*str == '-') {
+    } else if (ch == '-') {
         *endptr = const_cast<char*>(str + 1);
         return Sign::Negative;
     } else {
@@ -151,6 +262,35 @@ Sign strtosign(const char* str, char** endptr) {
     }
 }
 
+// SWAR ("SIMD within a register"): Look at eight characters at once.
+// Note that this assumes a little endian machine, just like the test runner.
+// Use `Bounds::can_load_eight_bytes` to check whether it's safe to look.
+
+// Reading past the NUL byte is intentional, see `Bounds::can_load_eight_bytes`.
+__attribute__((no_sanitize_address))
+uint64_t load_eight_bytes(const char* str) {
+    uint64_t chunk;
+    memcpy(&chunk, str, sizeof(chunk));
+    return chunk;
+}
+
+bool is_made_of_eight_digits(uint64_t chunk) {
+    // A byte is a digit iff it's at least 0x30 and adding 0x46 doesn't reach 0x80.
+    return !(((chunk + 0x4646464646464646ULL) | (chunk - 0x3030303030303030ULL)) & 0x8080808080808080ULL);
+}
+
+uint32_t parse_eight_digits(uint64_t chunk) {
+    // Combine adjacent digits into pairs, then pairs into quadruples, then the
+    // two quadruples into the result. The first character is the least significant byte.
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return static_cast<uint32_t>(chunk);
+}
+
 enum DigitConsumeDecision {
     Consumed,
     PosOverflow,
@@ -158,31 +298,21 @@ enum DigitConsumeDecision {
     Invalid,
 };
 
-template<typename T, T min_value, T max_value>
+// If `static_base` is nonzero, the base is known at compile time, and the
+// divisions in the constructor are folded away. Otherwise, it's `base`.
+template<typename T, T min_value, T max_value, int static_base = 0>
 class NumParser {
 public:
-    NumParser(Sign sign, int base)
+    NumParser(Sign sign, int base = static_base)
         : m_base(base), m_num(0), m_sign(sign)
     {
-        m_cutoff = positive() ? (max_value / base) : (min_value / base);
-        m_max_digit_after_cutoff = positive() ? (max_value % base) : (min_value % base);
+        assert(static_base == 0 || base == static_base);
+        m_cutoff = positive() ? (max_value / this->base()) : (min_value / this->base());
+        m_max_digit_after_cutoff = positive() ? (max_value % this->base()) : (min_value % this->base());
     }
 
     int parse_digit(char ch) {
-        int digit;
-        if (isdigit(ch))
-            digit = ch - '0';
-        else if (islower(ch))
-            digit = ch - ('a' - 10);
-        else if (isupper(ch))
-            digit = ch - ('A' - 10);
-        else
-            return -1;
-
-        if (digit >= m_base)
-            return -1;
-
-        return digit;
+        return digit_value(ch, base());
     }
 
     DigitConsumeDecision consume(char ch) {
@@ -198,12 +328,32 @@ public:
             }
         }
 
-        m_num *= m_base;
+        m_num *= base();
         m_num += positive() ? digit : -digit;
 
         return DigitConsumeDecision::Consumed;
     }
 
+    // For callers that already know the result fits, e.g. because of a digit limit.
+    void append_digit_unchecked(int digit) {
+        m_num *= base();
+        m_num += positive() ? digit : -digit;
+    }
+
+    // Appends eight decimal digits at once, see `parse_eight_digits`.
+    // Returns false (and consumes nothing) if the result might not fit.
+    // In that case, `consume` knows exactly where to stop.
+    bool consume_eight_digits(uint32_t value) {
+        assert(base() == 10);
+        if (positive() ? (m_num > EIGHT_DIGITS_CUTOFF_POS) : (m_num < EIGHT_DIGITS_CUTOFF_NEG))
+            return false;
+
+        m_num *= 100000000;
+        m_num += positive() ? static_cast<T>(value) : -static_cast<T>(value);
+
+        return true;
+    }
+
     T number() const { return m_num; };
 
 private:
@@ -215,7 +365,8 @@ private:
         if (is_below_cutoff) {
             return true;
         } else {
-            return m_num == m_cutoff && digit < m_max_digit_after_cutoff;
+            // `m_max_digit_after_cutoff` is negative for negative numbers.
+            return m_num == m_cutoff && digit <= (positive() ? m_max_digit_after_cutoff : -m_max_digit_after_cutoff);
         }
     }
 
@@ -223,306 +374,3173 @@ private:
         return m_sign != Sign::Negative;
     }
 
-    const T m_base;
+    T base() const {
+        return static_base != 0 ? static_base : m_base;
+    }
+
+    // Largest (or smallest) number that still has room for eight more digits,
+    // no matter which ones. Note that division rounds towards zero.
+    static constexpr T EIGHT_DIGITS_CUTOFF_POS = (max_value - 99999999) / 100000000;
+    static constexpr T EIGHT_DIGITS_CUTOFF_NEG = (min_value + 99999999) / 100000000;
+
+    T m_base;
     T m_num;
     T m_cutoff;
     int m_max_digit_after_cutoff;
     Sign m_sign;
 };
 
-#define INT_MAX 2147483647L
-#define INT_MIN (-LONG_MAX - 1L)
-#define LONG_MAX 2147483647L
-#define LONG_MIN (-LONG_MAX - 1L)
-#define LONG_LONG_MAX 9223372036854775807LL
-#define LONG_LONG_MIN (-LONG_LONG_MAX - 1LL)
-
 typedef NumParser<int, INT_MIN, INT_MAX> IntParser;
 typedef NumParser<long, LONG_MIN, LONG_MAX> LongParser;
-typedef NumParser<long long, LONG_LONG_MIN, LONG_LONG_MAX> LongLongParser;
-
-static const double MY_INFTY_POS = +1.0 / 0.0;
-static const double MY_INFTY_NEG = -1.0 / 0.0;
-static const double MY_NAN = -(0.0 / 0.0);
+typedef NumParser<long long, LLONG_MIN, LLONG_MAX> LongLongParser;
+typedef NumParser<unsigned long, 0, ULONG_MAX> ULongParser;
+typedef NumParser<unsigned long long, 0, ULLONG_MAX> ULongLongParser;
 
-bool is_either(char* str, int offset, char lower, char upper) {
-    char ch = *(str + offset);
+template<bool bounded>
+bool is_either(char* str, Bounds<bounded> bounds, int offset, char lower, char upper) {
+    char ch = bounds.at(str, offset);
     return ch == lower || ch == upper;
 }
 
-double new_strtod(const char* str, char** endptr) {
-    // Parse spaces, sign, and base
-    char* parse_ptr = const_cast<char*>(str);
-    strtons(parse_ptr, &parse_ptr);
-    const Sign sign = strtosign(parse_ptr, &parse_ptr);
+// Conversion engine: Turn "digits * 10^exponent" into the nearest double.
+//
+// Small cases are handled by Clinger's fast path: If both `digits` and
+// 10^|exponent| are exactly representable as doubles, then a single
+// IEEE multiplication or division is already correctly rounded.
+//
+// Everything else goes through the Eisel-Lemire algorithm: Normalize
+// `digits`, multiply it with a 128-bit truncated approximation of
+// 5^exponent, and read the mantissa off the top bits of the product.
+// The power of two is just a matter of bookkeeping. See:
+// - Daniel Lemire, "Number Parsing at a Gigabyte per Second" (2021)
+// - Noble Mushtak and Daniel Lemire, "Fast Number Parsing Without Fallback" (2023)
+// The second paper shows that (with exactly this table) the result is always
+// correct, as long as `digits` is exact.
 
-    // Parse inf/nan, if applicable.
-    if (is_either(parse_ptr, 0, 'i', 'I')) {
-        if (is_either(parse_ptr, 1, 'n', 'N')) {
-            if (is_either(parse_ptr, 2, 'f', 'F')) {
-                parse_ptr += 3;
-                if (is_either(parse_ptr, 0, 'i', 'I')) {
-                    if (is_either(parse_ptr, 1, 'n', 'N')) {
-                        if (is_either(parse_ptr, 2, 'i', 'I')) {
-                            if (is_either(parse_ptr, 3, 't', 'T')) {
-                                if (is_either(parse_ptr, 4, 'y', 'Y')) {
-                                    parse_ptr += 5;
-                                }
-                            }
-                        }
-                    }
-                }
-                if (endptr)
-                    *endptr = parse_ptr;
-                if (sign != Sign::Negative) {
-                    return MY_INFTY_POS;
-                } else {
-                    return MY_INFTY_NEG;
-                }
-            }
-        }
-    }
-    if (is_either(parse_ptr, 0, 'n', 'N')) {
-        if (is_either(parse_ptr, 1, 'a', 'A')) {
-            if (is_either(parse_ptr, 2, 'n', 'N')) {
-                if (endptr)
-                    *endptr = parse_ptr + 3;
-                if (sign != Sign::Negative) {
-                    return MY_NAN;
-                } else {
-                    return -MY_NAN;
-                }
-            }
+struct UInt128 {
+    uint64_t high;
+    uint64_t low;
+};
+
+constexpr UInt128 full_multiplication(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    // On 64-bit machines, this is a single instruction.
+    const __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return UInt128 { static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product) };
+#else
+    // On a 32-bit machine, do it the schoolbook way.
+    const uint64_t a_lo = a & 0xFFFFFFFFULL;
+    const uint64_t a_hi = a >> 32;
+    const uint64_t b_lo = b & 0xFFFFFFFFULL;
+    const uint64_t b_hi = b >> 32;
+
+    const uint64_t lo_lo = a_lo * b_lo;
+    const uint64_t hi_lo = a_hi * b_lo;
+    const uint64_t lo_hi = a_lo * b_hi;
+    const uint64_t hi_hi = a_hi * b_hi;
+
+    // Can't overflow: (2^32-1) + (2^32-1) + (2^32-1)^2 < 2^64
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+
+    return UInt128 { (hi_lo >> 32) + (cross >> 32) + hi_hi, (cross << 32) | (lo_lo & 0xFFFFFFFFULL) };
+#endif
+}
+
+// Smallest and largest `q` for which we store 5^q.
+// Outside of this range, the result is always 0.0 or INF, see `compute_float`.
+static const int POWER_OF_FIVE_MIN = -342;
+static const int POWER_OF_FIVE_MAX = 308;
+static const int NUM_POWERS_OF_FIVE = POWER_OF_FIVE_MAX - POWER_OF_FIVE_MIN + 1;
+
+// Just enough arbitrary precision arithmetic to generate the table at compile time.
+// 56 limbs of 32 bits each can hold 2^1760, which is what we need for 5^-342.
+static const int CONSTEXPR_BIGNUM_LIMBS = 56;
+
+struct ConstexprBignum {
+    // Little endian.
+    uint32_t limbs[CONSTEXPR_BIGNUM_LIMBS] {};
+
+    constexpr void multiply_small(uint32_t factor) {
+        uint64_t carry = 0;
+        for (int i = 0; i < CONSTEXPR_BIGNUM_LIMBS; ++i) {
+            const uint64_t product = static_cast<uint64_t>(limbs[i]) * factor + carry;
+            limbs[i] = static_cast<uint32_t>(product);
+            carry = product >> 32;
         }
+        assert(carry == 0);
     }
 
-    // Parse base
-    char exponent_lower;
-    char exponent_upper;
-    int base = 10;
-    if (*parse_ptr == '0') {
-        const char base_ch = *(parse_ptr + 1);
-        if (base_ch == 'x' || base_ch == 'X') {
-            base = 16;
-            parse_ptr += 2;
+    constexpr void divide_small(uint32_t divisor) {
+        // Rounds towards zero, i.e. `floor`.
+        uint64_t remainder = 0;
+        for (int i = CONSTEXPR_BIGNUM_LIMBS - 1; i >= 0; --i) {
+            const uint64_t current = (remainder << 32) | limbs[i];
+            limbs[i] = static_cast<uint32_t>(current / divisor);
+            remainder = current % divisor;
         }
     }
 
-    if (base == 10) {
-        exponent_lower = 'e';
-        exponent_upper = 'E';
-    } else {
-        exponent_lower = 'p';
-        exponent_upper = 'P';
+    constexpr void shift_right(int amount) {
+        const int limb_shift = amount / 32;
+        const int bit_shift = amount % 32;
+        for (int i = 0; i < CONSTEXPR_BIGNUM_LIMBS; ++i) {
+            const int src = i + limb_shift;
+            uint64_t value = 0;
+            if (src < CONSTEXPR_BIGNUM_LIMBS)
+                value = limbs[src];
+            if (src + 1 < CONSTEXPR_BIGNUM_LIMBS)
+                value |= static_cast<uint64_t>(limbs[src + 1]) << 32;
+            limbs[i] = static_cast<uint32_t>(value >> bit_shift);
+        }
     }
 
-    // Parse "digits", possibly keeping track of the exponent offset.
-    // We parse the most significant digits and the position in the
-    // base-`base` representation separately. This allows us to handle
-    // numbers like `0.0000000000000000000000000000000000001234` or
-    // `1234567890123456789012345678901234567890` with ease.
-    LongLongParser digits{sign, base};
-    bool digits_usable = false;
-    bool should_continue = true;
-    bool digits_overflow = false;
-    bool after_decimal = false;
-    int exponent = 0;
-    do {
-        if (!after_decimal && *parse_ptr == '.') {
-            after_decimal = true;
-            parse_ptr += 1;
-            continue;
+    constexpr void add_one() {
+        for (int i = 0; i < CONSTEXPR_BIGNUM_LIMBS; ++i) {
+            limbs[i] += 1;
+            if (limbs[i] != 0)
+                return;
         }
+        assert(false); // ASSERT_NOT_REACHED();
+    }
 
-        bool is_a_digit;
-        if (digits_overflow) {
-            is_a_digit = digits.parse_digit(*parse_ptr) != -1;
-        } else {
-            DigitConsumeDecision decision = digits.consume(*parse_ptr);
-            switch (decision) {
-            case DigitConsumeDecision::Consumed:
-                is_a_digit = true;
-                // The very first actual digit must pass here:
-                digits_usable = true;
-                break;
-            case DigitConsumeDecision::PosOverflow:
-                // fallthrough
-            case DigitConsumeDecision::NegOverflow:
-                is_a_digit = true;
-                digits_overflow = true;
-                break;
-            case DigitConsumeDecision::Invalid:
-                is_a_digit = false;
-                break;
-            default:
-                assert(false); // ASSERT_NOT_REACHED();
+    constexpr int bit_length() const {
+        for (int i = CONSTEXPR_BIGNUM_LIMBS - 1; i >= 0; --i) {
+            if (limbs[i] != 0) {
+                int bits = 32;
+                while (!(limbs[i] >> (bits - 1)))
+                    --bits;
+                return 32 * i + bits;
             }
         }
+        return 0;
+    }
 
-        if (is_a_digit) {
-            exponent -= after_decimal ? 1 : 0;
-            exponent += digits_overflow ? 1 : 0;
+    constexpr uint64_t extract_64_bits(int lowest_bit) const {
+        // Bits below position 0 are considered to be zero,
+        // so this can also shift numbers to the left.
+        uint64_t result = 0;
+        for (int i = 63; i >= 0; --i) {
+            const int pos = lowest_bit + i;
+            result <<= 1;
+            if (pos >= 0 && pos < 32 * CONSTEXPR_BIGNUM_LIMBS)
+                result |= (limbs[pos / 32] >> (pos % 32)) & 1;
         }
+        return result;
+    }
 
-        should_continue = is_a_digit;
-        parse_ptr += should_continue;
-    } while (should_continue);
+    constexpr UInt128 extract_top_128_bits() const {
+        const int length = bit_length();
+        return UInt128 { extract_64_bits(length - 64), extract_64_bits(length - 128) };
+    }
+};
 
-    if (!digits_usable) {
-        // No actual number value available.
-        if (endptr)
-            *endptr = const_cast<char*>(str);
-        return 0.0;
+struct PowersOfFive {
+    // Index `q - POWER_OF_FIVE_MIN`.
+    UInt128 entries[NUM_POWERS_OF_FIVE];
+};
+
+constexpr PowersOfFive generate_powers_of_five() {
+    PowersOfFive table {};
+
+    // Positive powers: Simply the most significant 128 bits of 5^q, truncated.
+    ConstexprBignum power {};
+    power.limbs[0] = 1;
+    for (int q = 0; q <= POWER_OF_FIVE_MAX; ++q) {
+        table.entries[q - POWER_OF_FIVE_MIN] = power.extract_top_128_bits();
+        power.multiply_small(5);
     }
 
-    // Parse exponent.
-    // We already know the next character is not a digit in the current base,
-    // nor a valid decimal point. Check whether it's an exponent sign.
-    if (*parse_ptr == exponent_lower || *parse_ptr == exponent_upper) {
-        // Need to keep the old parse_ptr around, in case of rollback.
-        char* old_parse_ptr = parse_ptr;
-        parse_ptr += 1;
+    // Negative powers: floor(2^b / 5^-q) + 1, truncated to 128 bits.
+    // For small `-q`, we pick `b` such that this needs no truncation.
+    // `reciprocal` is floor(2^1760 / 5^-q), so we only ever divide by 5.
+    ConstexprBignum reciprocal {};
+    reciprocal.limbs[CONSTEXPR_BIGNUM_LIMBS - 1] = 1;
+    power = ConstexprBignum {};
+    power.limbs[0] = 1;
+    for (int q = -1; q >= POWER_OF_FIVE_MIN; --q) {
+        reciprocal.divide_small(5);
+        power.multiply_small(5);
+        // Smallest `z` such that 2^z >= 5^-q.
+        const int z = power.bit_length();
+        const int b = (q >= -27) ? (z + 127) : (2 * z + 128);
+        ConstexprBignum entry = reciprocal;
+        entry.shift_right(32 * (CONSTEXPR_BIGNUM_LIMBS - 1) - b);
+        entry.add_one();
+        table.entries[q - POWER_OF_FIVE_MIN] = entry.extract_top_128_bits();
+    }
 
-        // Can't use atol or strtol here: Must accept excessive exponents,
-        // even exponents >64 bits.
-        Sign exponent_sign = strtosign(parse_ptr, &parse_ptr);
-        IntParser exponent_parser{exponent_sign, base};
-        bool exponent_usable = false;
-        bool exponent_overflow = false;
-        should_continue = true;
-        do {
-            bool is_a_digit;
-            if (exponent_overflow) {
-                is_a_digit = exponent_parser.parse_digit(*parse_ptr) != -1;
-            } else {
-                DigitConsumeDecision decision = exponent_parser.consume(*parse_ptr);
-                switch (decision) {
-                case DigitConsumeDecision::Consumed:
-                    is_a_digit = true;
-                    // The very first actual digit must pass here:
-                    exponent_usable = true;
-                    break;
-                case DigitConsumeDecision::PosOverflow:
-                    // fallthrough
-                case DigitConsumeDecision::NegOverflow:
-                    is_a_digit = true;
-                    exponent_overflow = true;
-                    break;
-                case DigitConsumeDecision::Invalid:
-                    is_a_digit = false;
-                    break;
-                default:
-                    assert(false); // ASSERT_NOT_REACHED();
-                }
-            }
+    return table;
+}
 
-            should_continue = is_a_digit;
-            parse_ptr += should_continue;
-        } while (should_continue);
+static constexpr PowersOfFive POWERS_OF_FIVE = generate_powers_of_five();
 
-        if (!exponent_usable) {
-            parse_ptr = old_parse_ptr;
-        } else if (exponent_overflow) {
-            // Technically this is wrong. If someone gives us 5GB of digits,
-            // and then an exponent of -5_000_000_000, the resulting exponent
-            // should be around 0.
-            // However, I think it's safe to assume that we never have to deal
-            // with that many digits anyway.
-            if (sign != Sign::Negative) {
-                exponent = INT_MIN;
-            } else {
-                exponent = INT_MAX;
-            }
-        } else {
-            // Literal exponent is usable and fits in an int.
-            // However, `exponent + exponent_parser.number()` might overflow an int.
-            // This would result in the wrong sign of the exponent!
-            long long new_exponent =
-                static_cast<long long>(exponent) + static_cast<long long>(exponent_parser.number());
-            if (new_exponent < INT_MIN) {
-                exponent = INT_MIN;
-            } else if (new_exponent > INT_MAX) {
-                exponent = INT_MAX;
-            } else {
-                exponent = static_cast<int>(new_exponent);
-            }
-        }
+// The formats the conversion engine can produce, as far as it is concerned.
+// `Value` is what we hand out: The native type if there is one, otherwise
+// just the bits. Only formats with a native type get Clinger's fast path.
+struct DoubleFormat {
+    typedef double Value;
+    typedef uint64_t Bits;
+    static const int mantissa_explicit_bits = 52;
+    static const int minimum_exponent = -1023;
+    static const int infinite_power = 0x7FF;
+    // Only for these `q` can "digits * 5^q" be exactly halfway between two values.
+    static const int min_exponent_round_to_even = -4;
+    static const int max_exponent_round_to_even = 23;
+    // Outside of these, the result is always zero or infinity.
+    static const int smallest_power_of_ten = -342;
+    static const int largest_power_of_ten = 308;
+    // Clinger: 10^22 is the largest power of ten that is exactly representable.
+    static const bool has_fast_path = true;
+    static const int max_exact_power_of_ten = 22;
+
+    static Value from_bits(Bits bits) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
     }
+};
 
-    // Parsing finished. now we only have to compute the result.
-    if (endptr)
-        *endptr = const_cast<char*>(parse_ptr);
+struct FloatFormat {
+    typedef float Value;
+    typedef uint32_t Bits;
+    static const int mantissa_explicit_bits = 23;
+    static const int minimum_exponent = -127;
+    static const int infinite_power = 0xFF;
+    static const int min_exponent_round_to_even = -17;
+    static const int max_exponent_round_to_even = 10;
+    static const int smallest_power_of_ten = -64;
+    static const int largest_power_of_ten = 38;
+    static const bool has_fast_path = true;
+    static const int max_exact_power_of_ten = 10;
 
-    // If `digits` is zero, we don't even have to look at `exponent`.
-    if (digits.number() == 0) {
-        if (sign != Sign::Negative) {
-            return 0.0;
-        } else {
-            return -0.0;
-        }
+    static Value from_bits(Bits bits) {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
     }
+};
 
-    // Deal with extreme exponents.
-    // The smallest normal is 2^-1022.
-    // The smallest denormal is 2^-1074.
-    // The largest number in `digits` is 2^63 - 1.
-    // Therefore, if "base^exponent" is smaller than 2^-(1074+63), the result is 0.0 anyway.
-    // This threshold is roughly 5.3566 * 10^-343.
-    // So if the resulting exponent is -344 or lower (closer to -inf),
-    // the result is 0.0 anyway.
-    // We only need to avoid false positives, so we can ignore base 16.
-    if (exponent <= -344) {
-        // Definitely can't be represented more precisely.
-        // I lied, sometimes the result is +0.0, and sometimes -0.0.
-        if (sign != Sign::Negative) {
-            return 0.0;
-        } else {
-            return -0.0;
-        }
+// IEEE 754 binary16.
+struct HalfFormat {
+    typedef uint16_t Value;
+    typedef uint16_t Bits;
+    static const int mantissa_explicit_bits = 10;
+    static const int minimum_exponent = -15;
+    static const int infinite_power = 0x1F;
+    static const int min_exponent_round_to_even = -22;
+    static const int max_exponent_round_to_even = 5;
+    static const int smallest_power_of_ten = -26;
+    static const int largest_power_of_ten = 4;
+    static const bool has_fast_path = false;
+    static const int max_exact_power_of_ten = 0;
+
+    static Value from_bits(Bits bits) {
+        return bits;
     }
-    // The largest normal is 2^+1024-eps.
-    // The smallest number in `digits` is 1.
-    // Therefore, if "base^exponent" is 2^+1024, the result is INF anyway.
-    // This threshold is roughly 1.7977 * 10^-308.
-    // So if the resulting exponent is +309 or higher,
-    // the result is INF anyway.
-    // We only need to avoid false positives, so we can ignore base 16.
-    if (exponent >= 309) {
-        // Definitely can't be represented more precisely.
-        // I lied, sometimes the result is +INF, and sometimes -INF.
-        if (sign != Sign::Negative) {
-            return MY_INFTY_POS;
-        } else {
-            return MY_INFTY_NEG;
+};
+
+// The top half of a float, i.e. same range, but only 8 bits of precision.
+struct BFloat16Format {
+    typedef uint16_t Value;
+    typedef uint16_t Bits;
+    static const int mantissa_explicit_bits = 7;
+    static const int minimum_exponent = -127;
+    static const int infinite_power = 0xFF;
+    static const int min_exponent_round_to_even = -24;
+    static const int max_exponent_round_to_even = 3;
+    static const int smallest_power_of_ten = -60;
+    static const int largest_power_of_ten = 38;
+    static const bool has_fast_path = false;
+    static const int max_exact_power_of_ten = 0;
+
+    static Value from_bits(Bits bits) {
+        return bits;
+    }
+};
+
+static const double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// 5^27 is the largest power of five that fits in a uint64_t.
+static const int MAX_POWER_OF_FIVE_IN_64_BITS = 27;
+
+// Where `compute_product_approximation` gets 5^q from. Both give exactly the same
+// entries, they only differ in how much memory they touch to do so.
+// The full table is 10 KB, which is fastest as long as nothing else competes
+// for the L1 cache.
+struct FullPowersOfFive {
+    static const UInt128& get(int q) {
+        return POWERS_OF_FIVE.entries[q - POWER_OF_FIVE_MIN];
+    }
+};
+
+// The compact table only keeps every 28th entry, and multiplies by the exact
+// 5^r (r <= 27 still fits into a uint64_t) to get the ones in between. Since the
+// stored entries are already truncated (or rounded up), the product can be off
+// by up to 3 in the last place, so we also keep those corrections, two bits per
+// entry. That's under 1 KB in total, for an extra multiplication per lookup.
+static const int COMPACT_POWER_STEP = MAX_POWER_OF_FIVE_IN_64_BITS + 1;
+static const int NUM_COMPACT_POWERS = (NUM_POWERS_OF_FIVE + COMPACT_POWER_STEP - 1) / COMPACT_POWER_STEP;
+
+struct CompactPowersOfFiveTable {
+    // Index `(q - POWER_OF_FIVE_MIN) / COMPACT_POWER_STEP`.
+    UInt128 bases[NUM_COMPACT_POWERS];
+    uint64_t small_powers[COMPACT_POWER_STEP];
+    // Index `q - POWER_OF_FIVE_MIN`, four per byte.
+    uint8_t corrections[(NUM_POWERS_OF_FIVE + 3) / 4];
+};
+
+// The top 128 bits of `base * factor`, before the correction.
+constexpr UInt128 multiply_compact_power(UInt128 base, uint64_t factor) {
+    const UInt128 low = full_multiplication(base.low, factor);
+    const UInt128 high = full_multiplication(base.high, factor);
+    // The product has 192 bits: `top`, `middle`, `low.low`.
+    const uint64_t middle = high.low + low.high;
+    const uint64_t top = high.high + (middle < high.low ? 1 : 0);
+    if (top == 0)
+        return UInt128 { middle, low.low };
+    const int shift = __builtin_clzll(top);
+    if (shift == 0)
+        return UInt128 { top, middle };
+    return UInt128 { (top << shift) | (middle >> (64 - shift)), (middle << shift) | (low.low >> (64 - shift)) };
+}
+
+constexpr CompactPowersOfFiveTable generate_compact_powers_of_five() {
+    CompactPowersOfFiveTable table {};
+    uint64_t power = 1;
+    for (int r = 0; r < COMPACT_POWER_STEP; ++r) {
+        table.small_powers[r] = power;
+        power *= 5;
+    }
+    for (int i = 0; i < NUM_POWERS_OF_FIVE; ++i) {
+        const UInt128 base = POWERS_OF_FIVE.entries[i - i % COMPACT_POWER_STEP];
+        if (i % COMPACT_POWER_STEP == 0)
+            table.bases[i / COMPACT_POWER_STEP] = base;
+        const UInt128 approximation = multiply_compact_power(base, table.small_powers[i % COMPACT_POWER_STEP]);
+        const UInt128& exact = POWERS_OF_FIVE.entries[i];
+        const uint64_t correction = exact.low - approximation.low;
+        // If this ever fails, the corrections need more bits.
+        assert(exact.high == approximation.high && correction <= 3);
+        table.corrections[i / 4] |= correction << (2 * (i % 4));
+    }
+    return table;
+}
+
+static constexpr CompactPowersOfFiveTable COMPACT_POWERS_OF_FIVE = generate_compact_powers_of_five();
+
+struct CompactPowersOfFive {
+    static UInt128 get(int q) {
+        const int index = q - POWER_OF_FIVE_MIN;
+        UInt128 power = multiply_compact_power(COMPACT_POWERS_OF_FIVE.bases[index / COMPACT_POWER_STEP],
+                                               COMPACT_POWERS_OF_FIVE.small_powers[index % COMPACT_POWER_STEP]);
+        // Never carries, see `generate_compact_powers_of_five`.
+        power.low += (COMPACT_POWERS_OF_FIVE.corrections[index / 4] >> (2 * (index % 4))) & 3;
+        return power;
+    }
+};
+
+// The result of the conversion, before packing it into an actual value.
+// `power2` is the biased exponent, and `mantissa` lacks the implicit bit.
+struct AdjustedMantissa {
+    uint64_t mantissa;
+    int power2;
+
+};
+
+int leading_zeroes(uint64_t value) {
+    assert(value != 0);
+    return __builtin_clzll(value);
+}
+
+// Roughly floor(log2(10^q)) + 63, for `q` within the table.
+int binary_power_of_ten(int q) {
+    return (((152170 + 65536) * q) >> 16) + 63;
+}
+
+template<typename Format, typename Powers>
+UInt128 compute_product_approximation(int q, uint64_t w) {
+    const UInt128 power = Powers::get(q);
+    UInt128 first_product = full_multiplication(w, power.high);
+    // We only need the top `mantissa_explicit_bits + 3` bits to be right.
+    // If the bits below are not all set, then adding the lower half can't carry into them.
+    const uint64_t precision_mask = 0xFFFFFFFFFFFFFFFFULL >> (Format::mantissa_explicit_bits + 3);
+    if ((first_product.high & precision_mask) == precision_mask) {
+        UInt128 second_product = full_multiplication(w, power.low);
+        first_product.low += second_product.high;
+        if (second_product.high > first_product.low)
+            first_product.high += 1;
+    }
+    return first_product;
+}
+
+// Like `compute_float`, but for "w * 2^exponent". There's nothing to approximate
+// here, we only need to round once. If `truncated` is set, then some nonzero
+// bits below `w` were dropped, so a tie is actually slightly above halfway.
+template<typename Format>
+AdjustedMantissa compute_float_binary(int exponent, uint64_t w, bool truncated) {
+    AdjustedMantissa answer { 0, 0 };
+    if (w == 0)
+        return answer;
+
+    const int lz = leading_zeroes(w);
+    w <<= lz;
+    // Now the top bit of `w` is worth 2^(exponent - lz + 63). This can't overflow
+    // in a long long, even if the exponent saturated.
+    const long long power2 = static_cast<long long>(exponent) - lz + 63 - Format::minimum_exponent;
+    if (power2 >= Format::infinite_power) {
+        answer.power2 = Format::infinite_power;
+        return answer;
+    }
+
+    // Keep the implicit bit and the explicit bits, and even fewer for denormals.
+    long long shift = 64 - Format::mantissa_explicit_bits - 1;
+    if (power2 <= 0)
+        shift += 1 - power2;
+    if (shift > 64) {
+        // Less than half of the smallest denormal: Rounds to zero.
+        return answer;
+    }
+
+    uint64_t mantissa = (shift == 64) ? 0 : (w >> shift);
+    const uint64_t remainder = (shift == 64) ? w : (w & ((1ULL << shift) - 1));
+    const uint64_t halfway = 1ULL << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (truncated || (mantissa & 1))))
+        mantissa += 1;
+
+    if (power2 <= 0) {
+        // Rounding up might have turned the denormal into the smallest normal.
+        answer.power2 = (mantissa < (1ULL << Format::mantissa_explicit_bits)) ? 0 : 1;
+    } else {
+        answer.power2 = static_cast<int>(power2);
+        if (mantissa >= (2ULL << Format::mantissa_explicit_bits)) {
+            // Rounding overflowed into the next binade.
+            mantissa = 1ULL << Format::mantissa_explicit_bits;
+            answer.power2 += 1;
         }
     }
 
-    // TODO: If `exponent` is large, this is slow.
-    double value = digits.number();
-    if (exponent < 0) {
-        exponent = -exponent;
-        for (int i = 0; i < exponent; ++i) {
-            // strtod is not supposed to return denormals.
-            // I don't think this is reasonable; return denormals anyway.
-            value /= base;
+    answer.mantissa = mantissa & ~(1ULL << Format::mantissa_explicit_bits);
+    if (answer.power2 >= Format::infinite_power) {
+        answer.mantissa = 0;
+        answer.power2 = Format::infinite_power;
+    }
+    return answer;
+}
+
+template<typename Format, typename Powers = FullPowersOfFive>
+AdjustedMantissa compute_float(int q, uint64_t w) {
+    AdjustedMantissa answer { 0, 0 };
+    if (w == 0 || q < Format::smallest_power_of_ten) {
+        // Too small: Rounds to zero.
+        return answer;
+    }
+    if (q > Format::largest_power_of_ten) {
+        // Too large: Rounds to infinity.
+        answer.power2 = Format::infinite_power;
+        return answer;
+    }
+
+    const uint64_t original_w = w;
+    const int lz = leading_zeroes(w);
+    w <<= lz;
+
+    // We need the implicit bit, one bit for rounding, and we might lose
+    // one more bit if the product turns out to be smaller than 2^127.
+    const UInt128 product = compute_product_approximation<Format, Powers>(q, w);
+    const int upperbit = static_cast<int>(product.high >> 63);
+    const int shift = upperbit + 64 - Format::mantissa_explicit_bits - 3;
+
+    answer.mantissa = product.high >> shift;
+    answer.power2 = binary_power_of_ten(q) + upperbit - lz - Format::minimum_exponent;
+
+    if (answer.power2 <= 0) {
+        // Denormal, or maybe even zero.
+        // For double and float, a denormal can't be exactly halfway between two
+        // values: That only happens for `q` close to 0. The 16-bit formats are
+        // small enough for that, though. But then "w * 10^q" is just
+        // "(w / 5^-q) * 2^q", and that's easy to round correctly.
+        if (q < 0 && q >= -MAX_POWER_OF_FIVE_IN_64_BITS) {
+            uint64_t power_of_five = 1;
+            for (int i = 0; i < -q; ++i)
+                power_of_five *= 5;
+            if (original_w % power_of_five == 0)
+                return compute_float_binary<Format>(q, original_w / power_of_five, false);
         }
-    } else if (exponent > 0) {
-        for (int i = 0; i < exponent; ++i) {
-            value *= base;
+
+        if (-answer.power2 + 1 >= 64) {
+            answer.mantissa = 0;
+            answer.power2 = 0;
+            return answer;
         }
+        answer.mantissa >>= -answer.power2 + 1;
+        answer.mantissa += answer.mantissa & 1;
+        answer.mantissa >>= 1;
+        // Rounding up might have turned the denormal into the smallest normal.
+        answer.power2 = (answer.mantissa < (1ULL << Format::mantissa_explicit_bits)) ? 0 : 1;
+        return answer;
     }
 
-    return value;
+    // Normally we round up, but if we are exactly halfway between two values,
+    // we have to round to even instead. That can only happen if nothing but
+    // zeros were shifted out, and 5^q fits in 64 bits (i.e. the product is exact).
+    if (product.low <= 1
+        && q >= Format::min_exponent_round_to_even
+        && q <= Format::max_exponent_round_to_even
+        && (answer.mantissa & 3) == 1
+        && (answer.mantissa << shift) == product.high) {
+        answer.mantissa &= ~1ULL;
+    }
+
+    answer.mantissa += answer.mantissa & 1;
+    answer.mantissa >>= 1;
+    if (answer.mantissa >= (2ULL << Format::mantissa_explicit_bits)) {
+        // Rounding overflowed into the next binade.
+        answer.mantissa = 1ULL << Format::mantissa_explicit_bits;
+        answer.power2 += 1;
+    }
+
+    answer.mantissa &= ~(1ULL << Format::mantissa_explicit_bits);
+    if (answer.power2 >= Format::infinite_power) {
+        answer.mantissa = 0;
+        answer.power2 = Format::infinite_power;
+    }
+    return answer;
 }
 
-struct Testcase {
-    const char* test_name;
-    int should_consume;
-    const char* hex;
-    const char* test_string;
-    bool skip_old = false;
+template<typename Format>
+typename Format::Value assemble_value(Sign sign, AdjustedMantissa am) {
+    typedef typename Format::Bits Bits;
+    Bits bits = static_cast<Bits>(am.mantissa | (static_cast<uint64_t>(am.power2) << Format::mantissa_explicit_bits));
+    if (sign == Sign::Negative)
+        bits |= static_cast<Bits>(1ULL << (8 * sizeof(Bits) - 1));
+    return Format::from_bits(bits);
+}
+
+template<typename Format>
+typename Format::Value zero_value(Sign sign) {
+    return assemble_value<Format>(sign, AdjustedMantissa { 0, 0 });
+}
+
+template<typename Format>
+typename Format::Value infinity_value(Sign sign) {
+    return assemble_value<Format>(sign, AdjustedMantissa { 0, Format::infinite_power });
+}
+
+// The quiet NaN, just like 0/0 (but with the requested sign).
+template<typename Format>
+typename Format::Value nan_value(Sign sign) {
+    return assemble_value<Format>(sign, AdjustedMantissa { 1ULL << (Format::mantissa_explicit_bits - 1), Format::infinite_power });
+}
+
+// Hot-path counters: Which of the paths below do real inputs actually take?
+// Build with -DMYSTRTOD_COUNTERS=1 (or `make counters`) to find out. Otherwise,
+// all the `count_*` functions are empty, and the compiler drops every call.
+// They're per thread, so counting needs neither atomics nor locks.
+#ifndef MYSTRTOD_COUNTERS
+#define MYSTRTOD_COUNTERS 0
+#endif
+
+// Every conversion ends up in exactly one of these.
+enum StrtodPath {
+    PathNoNumber,
+    PathInfinity,
+    PathNaN,
+    PathHex,
+    // Only zeros, so the exponent doesn't matter.
+    PathZero,
+    // Exponent clamping in `digits_to_value`: exponent <= -344 or >= 309.
+    PathTooSmall,
+    PathTooLarge,
+    // Up to 19 digits: Clinger's fast path, or else `compute_float`.
+    PathClinger,
+    PathEiselLemire,
+    // More digits: Either the first 19 are enough to decide, or it's the slow path.
+    PathManyDigits,
+    PathSlow,
 };
 
+static const int NUM_STRTOD_PATHS = 11;
+static const char* STRTOD_PATH_NAMES[NUM_STRTOD_PATHS] = {
+    "no number", "inf", "nan", "hex", "zero", "too small", "too large",
+    "clinger", "eisel-lemire", "many digits", "slow",
+};
+
+// Significant digits. Everything from 20 up goes in the last bucket,
+// since that's where the `long long` in `MantissaState` overflows.
+static const int STRTOD_DIGIT_BUCKETS = 21;
+// The decimal exponent, as in "digits * 10^exponent". The middle buckets are
+// the powers of ten that Clinger's fast path can use for doubles.
+static const int STRTOD_EXPONENT_BUCKETS = 5;
+static const char* STRTOD_EXPONENT_BUCKET_NAMES[STRTOD_EXPONENT_BUCKETS] = {
+    "..-23", "-22..-1", "0", "1..22", "23..",
+};
+
+struct StrtodCounters {
+    uint64_t paths[NUM_STRTOD_PATHS];
+    // These two only count nonzero decimal numbers.
+    uint64_t digits[STRTOD_DIGIT_BUCKETS];
+    uint64_t exponents[STRTOD_EXPONENT_BUCKETS];
+    // INT_MAX and INT_MIN respectively, until the first nonzero decimal number.
+    int min_exponent;
+    int max_exponent;
+};
+
+static const StrtodCounters EMPTY_STRTOD_COUNTERS = { {}, {}, {}, INT_MAX, INT_MIN };
+static thread_local StrtodCounters STRTOD_COUNTERS = EMPTY_STRTOD_COUNTERS;
+
+ALWAYS_INLINE void count_path(StrtodPath path) {
+    if constexpr (MYSTRTOD_COUNTERS)
+        STRTOD_COUNTERS.paths[path] += 1;
+}
+
+int strtod_exponent_bucket(int exponent) {
+    if (exponent < -22)
+        return 0;
+    if (exponent < 0)
+        return 1;
+    if (exponent == 0)
+        return 2;
+    return exponent <= 22 ? 3 : 4;
+}
+
+ALWAYS_INLINE void count_decimal(int num_digits, int exponent) {
+    if constexpr (MYSTRTOD_COUNTERS) {
+        StrtodCounters& counters = STRTOD_COUNTERS;
+        counters.digits[num_digits < STRTOD_DIGIT_BUCKETS - 1 ? num_digits : STRTOD_DIGIT_BUCKETS - 1] += 1;
+        counters.exponents[strtod_exponent_bucket(exponent)] += 1;
+        if (exponent < counters.min_exponent)
+            counters.min_exponent = exponent;
+        if (exponent > counters.max_exponent)
+            counters.max_exponent = exponent;
+    }
+}
+
+// A copy of the calling thread's counters. Always empty without MYSTRTOD_COUNTERS.
+StrtodCounters new_strtod_counters() {
+    return STRTOD_COUNTERS;
+}
+
+void new_strtod_reset_counters() {
+    STRTOD_COUNTERS = EMPTY_STRTOD_COUNTERS;
+}
+
+// Computes the value closest to "w * 10^exponent".
+template<typename Format, typename Powers = FullPowersOfFive>
+typename Format::Value decimal_to_value(Sign sign, uint64_t w, int exponent) {
+#if FLT_EVAL_METHOD == 0 || FLT_EVAL_METHOD == 1
+    // Clinger's fast path. The x87 FPU computes in extended precision,
+    // which would round twice, so this is only available with SSE2 or similar.
+    // (Computing a float in double precision is fine though: The product
+    // is exact, and the quotient is precise enough to only round once.)
+    if constexpr (Format::has_fast_path) {
+        typedef typename Format::Value Value;
+        if (w <= (2ULL << Format::mantissa_explicit_bits)
+            && -Format::max_exact_power_of_ten <= exponent
+            && exponent <= Format::max_exact_power_of_ten) {
+            Value value = static_cast<Value>(w);
+            if (exponent < 0) {
+                value /= static_cast<Value>(EXACT_POWERS_OF_TEN[-exponent]);
+            } else {
+                value *= static_cast<Value>(EXACT_POWERS_OF_TEN[exponent]);
+            }
+            count_path(PathClinger);
+            return sign != Sign::Negative ? value : -value;
+        }
+    }
+#endif
+
+    count_path(PathEiselLemire);
+    return assemble_value<Format>(sign, compute_float<Format, Powers>(exponent, w));
+}
+
+// Computes the value closest to "w * 2^exponent", i.e. the value of a hex float.
+template<typename Format>
+typename Format::Value hex_to_value(Sign sign, uint64_t w, int exponent, bool truncated) {
+    count_path(PathHex);
+    return assemble_value<Format>(sign, compute_float_binary<Format>(exponent, w, truncated));
+}
+
+// Slow path: If there are too many digits for `w`, then the true value lies
+// somewhere between "w * 10^q" and "(w + 1) * 10^q". Usually, both round to the
+// same value, but if not, they are neighbors, and we need to look at all the
+// digits to decide between them. Then all the digits, taken as one big integer,
+// are compared exactly against the point halfway between the two neighbors.
+// This is the "digit comparison" from fast_float, see also:
+// - Daniel Lemire, "Number Parsing at a Gigabyte per Second" (2021), section 11
+//
+// 768 digits are enough to decide the rounding of any double (and hence of the
+// narrower formats too); anything after that only matters for `truncated`.
+static const int DECIMAL_MAX_DIGITS = 768;
+
+// All the significant digits of a number, one digit per byte.
+// `truncated` means that some nonzero digits didn't fit.
+struct DecimalDigits {
+    int num_digits;
+    bool truncated;
+    uint8_t digits[DECIMAL_MAX_DIGITS];
+
+    void clear() {
+        num_digits = 0;
+        truncated = false;
+    }
+
+    void append(int digit) {
+        if (num_digits < DECIMAL_MAX_DIGITS) {
+            digits[num_digits] = static_cast<uint8_t>(digit);
+            num_digits += 1;
+        } else if (digit != 0) {
+            truncated = true;
+        }
+    }
+
+    // `chunk` is eight ASCII digits, as loaded from memory.
+    void append_eight(uint64_t chunk) {
+        if (num_digits > DECIMAL_MAX_DIGITS - 8) {
+            char text[8];
+            memcpy(text, &chunk, 8);
+            for (int i = 0; i < 8; ++i)
+                append(text[i] - '0');
+            return;
+        }
+        chunk -= 0x3030303030303030ULL;
+        memcpy(digits + num_digits, &chunk, 8);
+        num_digits += 8;
+    }
+
+    // Starts over with the digits of `value`.
+    void assign(uint64_t value) {
+        clear();
+        uint8_t reversed[20];
+        int length = 0;
+        do {
+            reversed[length] = static_cast<uint8_t>(value % 10);
+            length += 1;
+            value /= 10;
+        } while (value != 0);
+        while (length > 0) {
+            length -= 1;
+            append(reversed[length]);
+        }
+    }
+};
+
+// `MantissaState` collects overflowing digits here by default. Those are rare,
+// and keeping 800 bytes around in every parser would make every call pay for it.
+// One per thread, so that many threads can parse at once without any locking.
+static thread_local DecimalDigits DECIMAL_ARENA;
+
+// Just enough arbitrary precision arithmetic for the slow path, at runtime.
+// Unlike `ConstexprBignum`, this only touches the limbs that are actually in use,
+// and they're 64 bits wide, since `full_multiplication` makes that cheap.
+// The largest numbers we compare are 768 digits shifted left by a few bits,
+// or 5^1111 times a mantissa. Both are well below 2^3000.
+static const int DECIMAL_BIGNUM_LIMBS = 48;
+
+struct DecimalBignum {
+    // Little endian, and the top limb is never zero.
+    uint64_t limbs[DECIMAL_BIGNUM_LIMBS];
+    int length;
+
+    void assign(uint64_t value) {
+        limbs[0] = value;
+        length = (value != 0) ? 1 : 0;
+    }
+
+    // Computes "this * factor + addend".
+    void multiply_add(uint64_t factor, uint64_t addend) {
+        uint64_t carry = addend;
+        for (int i = 0; i < length; ++i) {
+            const UInt128 product = full_multiplication(limbs[i], factor);
+            limbs[i] = product.low + carry;
+            carry = product.high + ((limbs[i] < carry) ? 1 : 0);
+        }
+        if (carry != 0) {
+            assert(length < DECIMAL_BIGNUM_LIMBS);
+            limbs[length] = carry;
+            length += 1;
+        }
+    }
+
+    void multiply_by_power_of_five(int exponent) {
+        // 5^27 is the largest power of five that fits into a limb.
+        uint64_t factor = 1;
+        for (; exponent > 0; --exponent) {
+            if (factor > 0xFFFFFFFFFFFFFFFFULL / 5) {
+                multiply_add(factor, 0);
+                factor = 1;
+            }
+            factor *= 5;
+        }
+        if (factor > 1)
+            multiply_add(factor, 0);
+    }
+
+    void shift_left(int amount) {
+        if (length == 0)
+            return;
+        const int limb_shift = amount / 64;
+        const int bit_shift = amount % 64;
+        assert(length + limb_shift < DECIMAL_BIGNUM_LIMBS);
+        if (bit_shift == 0) {
+            for (int i = length - 1; i >= 0; --i)
+                limbs[i + limb_shift] = limbs[i];
+        } else {
+            // Going downwards, so that we never overwrite a limb we still need.
+            limbs[length + limb_shift] = limbs[length - 1] >> (64 - bit_shift);
+            for (int i = length - 1; i > 0; --i)
+                limbs[i + limb_shift] = (limbs[i] << bit_shift) | (limbs[i - 1] >> (64 - bit_shift));
+            limbs[limb_shift] = limbs[0] << bit_shift;
+            length += 1;
+        }
+        for (int i = 0; i < limb_shift; ++i)
+            limbs[i] = 0;
+        length += limb_shift;
+        if (limbs[length - 1] == 0)
+            length -= 1;
+    }
+
+    // Returns -1, 0 or 1, like memcmp.
+    int compare(const DecimalBignum& other) const {
+        if (length != other.length)
+            return (length < other.length) ? -1 : 1;
+        for (int i = length - 1; i >= 0; --i) {
+            if (limbs[i] != other.limbs[i])
+                return (limbs[i] < other.limbs[i]) ? -1 : 1;
+        }
+        return 0;
+    }
+};
+
+// Decides between `lower` and `upper`, the neighbors that "d * 10^exponent" lies
+// in between (where `d` is all the digits as one integer). It's `upper` exactly
+// if that's above the halfway point between them, or right on it and `lower` is odd.
+template<typename Format>
+AdjustedMantissa compute_float_digits(const DecimalDigits& d, int exponent, AdjustedMantissa lower, AdjustedMantissa upper) {
+    // Trailing zeros only make the integer larger.
+    int num_digits = d.num_digits;
+    while (num_digits > 0 && d.digits[num_digits - 1] == 0) {
+        num_digits -= 1;
+        exponent += 1;
+    }
+
+    DecimalBignum real;
+    real.length = 0;
+    for (int i = 0; i < num_digits; ) {
+        // 19 digits at a time, which is what fits into a limb.
+        const int chunk_end = (num_digits - i < 19) ? num_digits : i + 19;
+        uint64_t chunk = 0;
+        uint64_t scale = 1;
+        for (int j = i; j < chunk_end; ++j) {
+            chunk = 10 * chunk + d.digits[j];
+            scale *= 10;
+        }
+        real.multiply_add(scale, chunk);
+        i = chunk_end;
+    }
+
+    // `lower` is "mantissa * 2^power", so the halfway point is "(2 * mantissa + 1) * 2^(power - 1)".
+    uint64_t mantissa = lower.mantissa;
+    int power = Format::minimum_exponent + 1 - Format::mantissa_explicit_bits;
+    if (lower.power2 != 0) {
+        mantissa |= 1ULL << Format::mantissa_explicit_bits;
+        power += lower.power2 - 1;
+    }
+    DecimalBignum halfway;
+    halfway.assign(2 * mantissa + 1);
+
+    // Now compare "real * 10^exponent" with "halfway * 2^(power - 1)",
+    // after moving all the factors onto whichever side keeps them integers.
+    if (exponent >= 0) {
+        real.multiply_by_power_of_five(exponent);
+    } else {
+        halfway.multiply_by_power_of_five(-exponent);
+    }
+    const int shift = power - 1 - exponent;
+    if (shift >= 0) {
+        halfway.shift_left(shift);
+    } else {
+        real.shift_left(-shift);
+    }
+
+    int order = real.compare(halfway);
+    if (order == 0 && d.truncated) {
+        // There is something nonzero after the digits we kept.
+        order = 1;
+    }
+    if (order > 0 || (order == 0 && (mantissa & 1)))
+        return upper;
+    return lower;
+}
+
+// Computes "digits * 10^exponent", once parsing is done.
+// `digits` is what a `LongLongParser` made of the digits, so it already carries the sign.
+// If they didn't all fit, then `all_digits` has all of them, see `MantissaState`.
+template<typename Format, typename Powers = FullPowersOfFive>
+typename Format::Value digits_to_value(Sign sign, long long digits, int exponent, const DecimalDigits* all_digits) {
+    // If `digits` is zero, we don't even have to look at `exponent`.
+    if (digits == 0) {
+        count_path(PathZero);
+        return zero_value<Format>(sign);
+    }
+    if constexpr (MYSTRTOD_COUNTERS) {
+        int num_digits = all_digits ? all_digits->num_digits : 0;
+        for (long long rest = digits; !all_digits && rest != 0; rest /= 10)
+            num_digits += 1;
+        count_decimal(num_digits, exponent);
+    }
+
+    // Deal with extreme exponents.
+    // The smallest normal is 2^-1022.
+    // The smallest denormal is 2^-1074.
+    // The largest number in `digits` is 2^63 - 1.
+    // Therefore, if "10^exponent" is smaller than 2^-(1074+63), the result is 0.0 anyway.
+    // This threshold is roughly 5.3566 * 10^-343.
+    // So if the resulting exponent is -344 or lower (closer to -inf),
+    // the result is 0.0 anyway. The narrower formats get there even sooner,
+    // but `compute_float` takes care of that.
+    if (exponent <= -344) {
+        // Definitely can't be represented more precisely.
+        // I lied, sometimes the result is +0.0, and sometimes -0.0.
+        count_path(PathTooSmall);
+        return zero_value<Format>(sign);
+    }
+    // The largest normal is 2^+1024-eps.
+    // The smallest number in `digits` is 1.
+    // Therefore, if "10^exponent" is 2^+1024, the result is INF anyway.
+    // This threshold is roughly 1.7977 * 10^-308.
+    // So if the resulting exponent is +309 or higher,
+    // the result is INF anyway.
+    if (exponent >= 309) {
+        // Definitely can't be represented more precisely.
+        // I lied, sometimes the result is +INF, and sometimes -INF.
+        count_path(PathTooLarge);
+        return infinity_value<Format>(sign);
+    }
+
+    // `digits` carries the sign, but the conversion engine wants the magnitude.
+    // Note that -LLONG_MIN doesn't fit in a long long, but it fits in a uint64_t.
+    uint64_t magnitude = static_cast<uint64_t>(digits);
+    if (sign == Sign::Negative)
+        magnitude = -magnitude;
+    if (!all_digits)
+        return decimal_to_value<Format, Powers>(sign, magnitude, exponent);
+
+    // The true value is somewhere in between these two, see `DecimalDigits`.
+    const AdjustedMantissa lower = compute_float<Format, Powers>(exponent, magnitude);
+    const AdjustedMantissa upper = compute_float<Format, Powers>(exponent, magnitude + 1);
+    if (lower.mantissa == upper.mantissa && lower.power2 == upper.power2) {
+        count_path(PathManyDigits);
+        return assemble_value<Format>(sign, lower);
+    }
+    count_path(PathSlow);
+
+    // `all_digits` starts with the digits of `magnitude`, followed by the ones that didn't fit.
+    int digits_exponent = exponent - all_digits->num_digits;
+    for (uint64_t rest = magnitude; rest != 0; rest /= 10)
+        digits_exponent += 1;
+    return assemble_value<Format>(sign, compute_float_digits<Format>(*all_digits, digits_exponent, lower, upper));
+}
+
+// Parses "digits", possibly keeping track of the exponent offset.
+// We parse the most significant digits and the position in the
+// base-`base` representation separately. This allows us to handle
+// numbers like `0.0000000000000000000000000000000000001234` or
+// `1234567890123456789012345678901234567890` with ease.
+// If `max_digits` is nonzero, parsing stops after that many significant digits.
+// As long as that's at most 18, they always fit, so we can skip the overflow checks.
+// Leading zeros don't change the value, so they don't count.
+template<int static_base = 0, int max_digits = 0>
+struct MantissaState {
+    static_assert(max_digits >= 0 && max_digits <= 18, "Only supports digit limits that can't overflow");
+
+    NumParser<long long, LLONG_MIN, LLONG_MAX, static_base> digits;
+    bool digits_usable = false;
+    bool digits_overflow = false;
+    bool after_decimal = false;
+    int exponent = 0;
+    // Significant digits so far, only counted if `max_digits` is nonzero.
+    int num_digits = 0;
+    // Once `digits` overflows, all digits (including the ones in `digits`) go here,
+    // so that we can still round correctly. Defaults to `DECIMAL_ARENA`.
+    // Only for base 10, which is the only base we use this struct for anyway.
+    DecimalDigits* all_digits = nullptr;
+
+    MantissaState(Sign sign, int base = static_base)
+        : digits{sign, base}
+    {
+    }
+
+    // Returns whether `ch` is still part of the mantissa.
+    bool consume(char ch) {
+        if (!after_decimal && ch == '.') {
+            after_decimal = true;
+            return true;
+        }
+
+        if constexpr (max_digits != 0) {
+            const int digit = digits.parse_digit(ch);
+            if (digit == -1 || num_digits == max_digits)
+                return false;
+            digits.append_digit_unchecked(digit);
+            num_digits += (num_digits != 0 || digit != 0) ? 1 : 0;
+            digits_usable = true;
+            exponent -= after_decimal ? 1 : 0;
+            return true;
+        }
+
+        bool is_a_digit;
+        if (digits_overflow) {
+            const int digit = digits.parse_digit(ch);
+            is_a_digit = digit != -1;
+            if (is_a_digit)
+                all_digits->append(digit);
+        } else {
+            DigitConsumeDecision decision = digits.consume(ch);
+            switch (decision) {
+            case DigitConsumeDecision::Consumed:
+                is_a_digit = true;
+                // The very first actual digit must pass here:
+                digits_usable = true;
+                break;
+            case DigitConsumeDecision::PosOverflow:
+                // fallthrough
+            case DigitConsumeDecision::NegOverflow:
+                is_a_digit = true;
+                digits_overflow = true;
+                spill_digits(digits.parse_digit(ch));
+                break;
+            case DigitConsumeDecision::Invalid:
+                is_a_digit = false;
+                break;
+            default:
+                assert(false); // ASSERT_NOT_REACHED();
+            }
+        }
+
+        if (is_a_digit) {
+            exponent -= after_decimal ? 1 : 0;
+            exponent += digits_overflow ? 1 : 0;
+        }
+
+        return is_a_digit;
+    }
+
+    // Fast path for base 10: Consumes eight digits at once, if that's what
+    // `chunk` contains and they can't overflow. Otherwise, consumes nothing.
+    bool consume_eight_digits(uint64_t chunk) {
+        if (!is_made_of_eight_digits(chunk))
+            return false;
+        if (digits_overflow) {
+            // Past the first 19 digits, they only need to be kept around.
+            all_digits->append_eight(chunk);
+            exponent += after_decimal ? 0 : 8;
+            return true;
+        }
+        if (max_digits != 0 && num_digits > max_digits - 8)
+            return false;
+        if (!digits.consume_eight_digits(parse_eight_digits(chunk)))
+            return false;
+        if constexpr (max_digits != 0) {
+            if (num_digits != 0) {
+                num_digits += 8;
+            } else {
+                // Everything so far was leading zeros, so the value has exactly
+                // as many digits as are significant.
+                for (long long rest = digits.number(); rest != 0; rest /= 10)
+                    num_digits += 1;
+            }
+        }
+        digits_usable = true;
+        exponent -= after_decimal ? 8 : 0;
+        return true;
+    }
+
+    // `exponent` is the final decimal exponent, including the literal one.
+    template<typename Format, typename Powers = FullPowersOfFive>
+    typename Format::Value to_value(Sign sign, int final_exponent) const {
+        return digits_to_value<Format, Powers>(sign, digits.number(), final_exponent, digits_overflow ? all_digits : nullptr);
+    }
+
+    // `digits` just overflowed because of `digit`.
+    void spill_digits(int digit) {
+        if (!all_digits)
+            all_digits = &DECIMAL_ARENA;
+        uint64_t magnitude = static_cast<uint64_t>(digits.number());
+        if (digits.number() < 0)
+            magnitude = -magnitude;
+        all_digits->assign(magnitude);
+        all_digits->append(digit);
+    }
+};
+
+// Parses the digits of a hex float. These map directly onto bits, so we
+// keep the first 61 to 64 significant bits, and only remember whether
+// anything nonzero came after them. `exponent` counts bits, not digits.
+struct HexMantissaState {
+    uint64_t bits = 0;
+    bool digits_usable = false;
+    bool truncated = false;
+    bool after_decimal = false;
+    int exponent = 0;
+
+    // Unlike `MantissaState`, the sign only matters at the very end.
+    explicit HexMantissaState(Sign)
+    {
+    }
+
+    // Returns whether `ch` is still part of the mantissa.
+    bool consume(char ch) {
+        if (!after_decimal && ch == '.') {
+            after_decimal = true;
+            return true;
+        }
+
+        const int digit = digit_value(ch, 16);
+        if (digit == -1)
+            return false;
+
+        digits_usable = true;
+        if ((bits >> 60) == 0) {
+            // Leading zeros end up here too, so they don't take up any room.
+            bits = (bits << 4) | digit;
+            exponent -= after_decimal ? 4 : 0;
+        } else {
+            truncated |= digit != 0;
+            exponent += after_decimal ? 0 : 4;
+        }
+        return true;
+    }
+
+    bool consume_eight_digits(uint64_t) {
+        return false;
+    }
+
+    // `exponent` is the final binary exponent, including the literal one.
+    // No powers of ten involved here, so `Powers` doesn't matter.
+    template<typename Format, typename Powers = FullPowersOfFive>
+    typename Format::Value to_value(Sign sign, int final_exponent) const {
+        return hex_to_value<Format>(sign, bits, final_exponent, truncated);
+    }
+};
+
+// Which of the above parses the mantissa for a given base.
+template<int base, int max_digits>
+struct MantissaFor {
+    typedef MantissaState<base, max_digits> Type;
+};
+
+template<int max_digits>
+struct MantissaFor<16, max_digits> {
+    typedef HexMantissaState Type;
+};
+
+// Parses the digits of an exponent, after the exponent marker and sign.
+template<int static_base = 0>
+struct ExponentState {
+    // Can't use atol or strtol here: Must accept excessive exponents,
+    // even exponents >64 bits.
+    NumParser<int, INT_MIN, INT_MAX, static_base> exponent_parser;
+    Sign exponent_sign;
+    bool exponent_usable = false;
+    bool exponent_overflow = false;
+
+    ExponentState(Sign sign, int base = static_base)
+        : exponent_parser{sign, base}
+        , exponent_sign(sign)
+    {
+    }
+
+    // Returns whether `ch` is still part of the exponent.
+    bool consume(char ch) {
+        if (exponent_overflow)
+            return exponent_parser.parse_digit(ch) != -1;
+
+        DigitConsumeDecision decision = exponent_parser.consume(ch);
+        switch (decision) {
+        case DigitConsumeDecision::Consumed:
+            // The very first actual digit must pass here:
+            exponent_usable = true;
+            return true;
+        case DigitConsumeDecision::PosOverflow:
+            // fallthrough
+        case DigitConsumeDecision::NegOverflow:
+            exponent_overflow = true;
+            return true;
+        case DigitConsumeDecision::Invalid:
+            return false;
+        default:
+            assert(false); // ASSERT_NOT_REACHED();
+            return false;
+        }
+    }
+
+    // Adds the literal exponent to the exponent offset from the mantissa.
+    // Only meaningful if `exponent_usable`.
+    int apply_to(int exponent) const {
+        if (exponent_overflow) {
+            // Technically this is wrong. If someone gives us 5GB of digits,
+            // and then an exponent of -5_000_000_000, the resulting exponent
+            // should be around 0.
+            // However, I think it's safe to assume that we never have to deal
+            // with that many digits anyway.
+            if (exponent_sign != Sign::Negative) {
+                return INT_MAX;
+            } else {
+                return INT_MIN;
+            }
+        }
+
+        // Literal exponent is usable and fits in an int.
+        // However, `exponent + exponent_parser.number()` might overflow an int.
+        // This would result in the wrong sign of the exponent!
+        long long new_exponent =
+            static_cast<long long>(exponent) + static_cast<long long>(exponent_parser.number());
+        if (new_exponent < INT_MIN) {
+            return INT_MIN;
+        } else if (new_exponent > INT_MAX) {
+            return INT_MAX;
+        } else {
+            return static_cast<int>(new_exponent);
+        }
+    }
+};
+
+bool is_exponent_marker(char ch, int base) {
+    if (base == 10) {
+        return ch == 'e' || ch == 'E';
+    } else {
+        return ch == 'p' || ch == 'P';
+    }
+}
+
+// Describes the grammar that `policy_strtod` accepts, at compile time.
+// Everything a policy disables is compiled out entirely, including the checks.
+// This one accepts everything `new_strtod` accepts.
+struct StrtodPolicy {
+    static constexpr bool leading_space = true;
+    static constexpr bool sign = true;
+    static constexpr bool special_values = true;
+    static constexpr bool hex = true;
+    static constexpr bool exponent = true;
+    // Nonzero means: Stop after this many digits, see `MantissaState`.
+    static constexpr int max_digits = 0;
+    // Where the powers of ten come from, see `FullPowersOfFive`.
+    typedef FullPowersOfFive Powers;
+};
+
+// Same grammar, but with the compact table. For callers that parse in between
+// other work, and would rather keep their own data in the cache.
+struct CompactStrtodPolicy : StrtodPolicy {
+    typedef CompactPowersOfFive Powers;
+};
+
+// Known-format columns, like "1234.5678": No space, sign, inf/nan, hex, or exponent.
+struct PlainDecimalPolicy {
+    static constexpr bool leading_space = false;
+    static constexpr bool sign = false;
+    static constexpr bool special_values = false;
+    static constexpr bool hex = false;
+    static constexpr bool exponent = false;
+    static constexpr int max_digits = 18;
+    typedef FullPowersOfFive Powers;
+};
+
+// Parses digits and exponent into `mantissa` and `*exponent`, after the sign and
+// base prefix, and moves `*parse_ptr` to the end of the number.
+// Returns false if there are no digits at all. Then there is no number, and
+// `*parse_ptr` is meaningless.
+template<int base, bool with_exponent, typename Mantissa, bool bounded>
+ALWAYS_INLINE bool parse_mantissa_and_exponent(char** parse_ptr_inout, Bounds<bounded> bounds, Mantissa& mantissa, int* exponent_out) {
+    // Parse "digits", possibly keeping track of the exponent offset.
+    // See `MantissaState` for why this is done separately.
+    char* parse_ptr = *parse_ptr_inout;
+    while (true) {
+        // Fast path: Eight decimal digits at a time, until we get close to overflowing.
+        while (base == 10 && bounds.can_load_eight_bytes(parse_ptr)
+               && mantissa.consume_eight_digits(load_eight_bytes(parse_ptr))) {
+            parse_ptr += 8;
+        }
+
+        if (!mantissa.consume(bounds.at(parse_ptr)))
+            break;
+        parse_ptr += 1;
+    }
+
+    if (!mantissa.digits_usable)
+        return false;
+
+    // Parse exponent.
+    // We already know the next character is not a digit in the current base,
+    // nor a valid decimal point. Check whether it's an exponent sign.
+    int exponent = mantissa.exponent;
+    if (with_exponent && is_exponent_marker(bounds.at(parse_ptr), base)) {
+        // Need to keep the old parse_ptr around, in case of rollback.
+        char* old_parse_ptr = parse_ptr;
+        parse_ptr += 1;
+
+        // Even for hex floats, the exponent is decimal (and counts bits).
+        Sign exponent_sign = strtosign(parse_ptr, bounds, &parse_ptr);
+        ExponentState<10> exponent_state{exponent_sign};
+        while (exponent_state.consume(bounds.at(parse_ptr))) {
+            parse_ptr += 1;
+        }
+
+        if (!exponent_state.exponent_usable) {
+            parse_ptr = old_parse_ptr;
+        } else {
+            exponent = exponent_state.apply_to(exponent);
+        }
+    }
+
+    *parse_ptr_inout = parse_ptr;
+    *exponent_out = exponent;
+    return true;
+}
+
+// Parses digits and exponent, after the sign and base prefix.
+// `str` is only needed in case there are no digits at all: That's where parsing ends then.
+template<typename Format, typename Policy, int base, bool bounded>
+ALWAYS_INLINE typename Format::Value parse_strtod_digits(const char* str, char* parse_ptr, Bounds<bounded> bounds, Sign sign, char** endptr) {
+    typename MantissaFor<base, Policy::max_digits>::Type mantissa{sign};
+    int exponent;
+    if (!parse_mantissa_and_exponent<base, Policy::exponent>(&parse_ptr, bounds, mantissa, &exponent)) {
+        // No actual number value available.
+        count_path(base == 16 ? PathZero : PathNoNumber);
+        if (endptr)
+            *endptr = const_cast<char*>(str);
+        // Unless it's "0x" followed by garbage, then it's a signed zero.
+        return zero_value<Format>(base == 16 ? sign : Sign::Positive);
+    }
+
+    // Parsing finished. now we only have to compute the result.
+    if (endptr)
+        *endptr = const_cast<char*>(parse_ptr);
+
+    return mantissa.template to_value<Format, typename Policy::Powers>(sign, exponent);
+}
+
+// The actual parser behind `new_strtod`. It's forced inline so that bulk
+// callers like `new_strtod_batch` don't pay for a call per number.
+template<typename Format, typename Policy, bool bounded>
+ALWAYS_INLINE typename Format::Value parse_strtod(const char* str, Bounds<bounded> bounds, char** endptr) {
+    // Parse spaces, sign, and base
+    char* parse_ptr = const_cast<char*>(str);
+    if constexpr (Policy::leading_space)
+        strtons(parse_ptr, bounds, &parse_ptr);
+    Sign sign = Sign::Positive;
+    if constexpr (Policy::sign)
+        sign = strtosign(parse_ptr, bounds, &parse_ptr);
+
+    // Parse inf/nan, if applicable.
+    if constexpr (Policy::special_values) {
+        if (is_either(parse_ptr, bounds, 0, 'i', 'I')) {
+            if (is_either(parse_ptr, bounds, 1, 'n', 'N')) {
+                if (is_either(parse_ptr, bounds, 2, 'f', 'F')) {
+                    parse_ptr += 3;
+                    if (is_either(parse_ptr, bounds, 0, 'i', 'I')) {
+                        if (is_either(parse_ptr, bounds, 1, 'n', 'N')) {
+                            if (is_either(parse_ptr, bounds, 2, 'i', 'I')) {
+                                if (is_either(parse_ptr, bounds, 3, 't', 'T')) {
+                                    if (is_either(parse_ptr, bounds, 4, 'y', 'Y')) {
+                                        parse_ptr += 5;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    if (endptr)
+                        *endptr = parse_ptr;
+                    count_path(PathInfinity);
+                    return infinity_value<Format>(sign);
+                }
+            }
+        }
+        if (is_either(parse_ptr, bounds, 0, 'n', 'N')) {
+            if (is_either(parse_ptr, bounds, 1, 'a', 'A')) {
+                if (is_either(parse_ptr, bounds, 2, 'n', 'N')) {
+                    if (endptr)
+                        *endptr = parse_ptr + 3;
+                    count_path(PathNaN);
+                    return nan_value<Format>(sign);
+                }
+            }
+        }
+    }
+
+    // Parse base
+    if constexpr (Policy::hex) {
+        if (bounds.at(parse_ptr) == '0') {
+            const char base_ch = bounds.at(parse_ptr, 1);
+            if (base_ch == 'x' || base_ch == 'X') {
+                // Without any hex digits, something like "0xg" is just a zero followed by garbage.
+                parse_ptr += 2;
+                return parse_strtod_digits<Format, Policy, 16>(parse_ptr - 1, parse_ptr, bounds, sign, endptr);
+            }
+        }
+    }
+
+    return parse_strtod_digits<Format, Policy, 10>(str, parse_ptr, bounds, sign, endptr);
+}
+
+double new_strtod(const char* str, char** endptr) {
+    return parse_strtod<DoubleFormat, StrtodPolicy>(str, NulTerminated { nullptr }, endptr);
+}
+
+// Same as above, but for input that is not NUL-terminated, like a field in an
+// mmapped file. Never reads at or past `last`.
+double new_strtod(const char* first, const char* last, char** endptr) {
+    return parse_strtod<DoubleFormat, StrtodPolicy>(first, Range { last }, endptr);
+}
+
+// Same grammar as `new_strtod`, but rounds directly to the narrower format.
+// Going through double first would round twice, which is sometimes wrong.
+float new_strtof(const char* str, char** endptr) {
+    return parse_strtod<FloatFormat, StrtodPolicy>(str, NulTerminated { nullptr }, endptr);
+}
+
+float new_strtof(const char* first, const char* last, char** endptr) {
+    return parse_strtod<FloatFormat, StrtodPolicy>(first, Range { last }, endptr);
+}
+
+// There's no native type for these, so they return the bits instead.
+uint16_t new_strtof16(const char* str, char** endptr) {
+    return parse_strtod<HalfFormat, StrtodPolicy>(str, NulTerminated { nullptr }, endptr);
+}
+
+uint16_t new_strtof16(const char* first, const char* last, char** endptr) {
+    return parse_strtod<HalfFormat, StrtodPolicy>(first, Range { last }, endptr);
+}
+
+uint16_t new_strtobf16(const char* str, char** endptr) {
+    return parse_strtod<BFloat16Format, StrtodPolicy>(str, NulTerminated { nullptr }, endptr);
+}
+
+uint16_t new_strtobf16(const char* first, const char* last, char** endptr) {
+    return parse_strtod<BFloat16Format, StrtodPolicy>(first, Range { last }, endptr);
+}
+
+// Like `new_strtod`, but only accepts what `Policy` allows, e.g. `PlainDecimalPolicy`.
+template<typename Policy>
+double policy_strtod(const char* str, char** endptr) {
+    return parse_strtod<DoubleFormat, Policy>(str, NulTerminated { nullptr }, endptr);
+}
+
+template<typename Policy>
+double policy_strtod(const char* first, const char* last, char** endptr) {
+    return parse_strtod<DoubleFormat, Policy>(first, Range { last }, endptr);
+}
+
+// Consumes a run of decimal digits, but not a decimal point: JSON only allows
+// one where a digit follows, so `parse_json_number` checks that itself.
+template<bool bounded>
+ALWAYS_INLINE char* consume_json_digits(MantissaState<10>& mantissa, char* parse_ptr, Bounds<bounded> bounds) {
+    while (true) {
+        while (bounds.can_load_eight_bytes(parse_ptr) && mantissa.consume_eight_digits(load_eight_bytes(parse_ptr))) {
+            parse_ptr += 8;
+        }
+
+        const char ch = bounds.at(parse_ptr);
+        if (digit_value(ch, 10) == -1)
+            return parse_ptr;
+        mantissa.consume(ch);
+        parse_ptr += 1;
+    }
+}
+
+// Exactly the RFC 8259 number grammar, and nothing else:
+//     number = [ "-" ] ( "0" / [1-9] *DIGIT ) [ "." 1*DIGIT ] [ ( "e" / "E" ) [ "-" / "+" ] 1*DIGIT ]
+// So no leading space, no '+', no inf/nan, no hex, and none of the checks for them.
+// Like `new_strtod`, this parses the longest prefix that is a number. So "01"
+// is a zero followed by garbage, and "1." is a one followed by garbage. It's
+// up to the caller to decide whether the next character may follow a number.
+// If there is no number at all (e.g. "-", ".5", "+1"), `*endptr` is `str`.
+template<typename Format, bool bounded>
+ALWAYS_INLINE typename Format::Value parse_json_number(const char* str, Bounds<bounded> bounds, char** endptr) {
+    char* parse_ptr = const_cast<char*>(str);
+    Sign sign = Sign::Positive;
+    if (bounds.at(parse_ptr) == '-') {
+        sign = Sign::Negative;
+        parse_ptr += 1;
+    }
+
+    // Integer part: A lone zero, or digits without leading zeros.
+    MantissaState<10> mantissa{sign};
+    const char first = bounds.at(parse_ptr);
+    if (first == '0') {
+        mantissa.consume(first);
+        parse_ptr += 1;
+    } else if (digit_value(first, 10) != -1) {
+        parse_ptr = consume_json_digits(mantissa, parse_ptr, bounds);
+    } else {
+        count_path(PathNoNumber);
+        if (endptr)
+            *endptr = const_cast<char*>(str);
+        return zero_value<Format>(Sign::Positive);
+    }
+
+    // Fraction: Only if at least one digit follows the point.
+    if (bounds.at(parse_ptr) == '.' && digit_value(bounds.at(parse_ptr, 1), 10) != -1) {
+        mantissa.consume('.');
+        parse_ptr = consume_json_digits(mantissa, parse_ptr + 1, bounds);
+    }
+
+    // Exponent: Same rollback as in `parse_strtod_digits`.
+    int exponent = mantissa.exponent;
+    const char marker = bounds.at(parse_ptr);
+    if (marker == 'e' || marker == 'E') {
+        char* exponent_ptr = parse_ptr + 1;
+        Sign exponent_sign = strtosign(exponent_ptr, bounds, &exponent_ptr);
+        ExponentState<10> exponent_state{exponent_sign};
+        while (exponent_state.consume(bounds.at(exponent_ptr))) {
+            exponent_ptr += 1;
+        }
+
+        if (exponent_state.exponent_usable) {
+            parse_ptr = exponent_ptr;
+            exponent = exponent_state.apply_to(exponent);
+        }
+    }
+
+    if (endptr)
+        *endptr = parse_ptr;
+
+    return mantissa.to_value<Format>(sign, exponent);
+}
+
+double new_strtod_json(const char* str, char** endptr) {
+    return parse_json_number<DoubleFormat>(str, NulTerminated { nullptr }, endptr);
+}
+
+double new_strtod_json(const char* first, const char* last, char** endptr) {
+    return parse_json_number<DoubleFormat>(first, Range { last }, endptr);
+}
+
+// Fixed point: "12.3456" with `scale` 4 is 123456, exactly, using nothing but
+// integer arithmetic. Same grammar as `PlainDecimalPolicy`, plus a sign, leading
+// whitespace and an exponent, since "1.5e-3" is a perfectly fine price.
+// The result is rounded towards zero. These say what got lost on the way:
+enum FixedPointFlag {
+    // Too large for an int64 after scaling, so the result saturates.
+    FixedOverflow = 1,
+    // There were nonzero digits beyond `scale` decimals.
+    FixedTruncated = 2,
+};
+
+static const int FIXED_POINT_MAX_SCALE = 18;
+
+static const long long INT_POWERS_OF_TEN[FIXED_POINT_MAX_SCALE + 1] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL,
+    1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL,
+    100000000000000LL, 1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL,
+};
+
+// Whether any of the digits after the first `kept` ones is nonzero.
+bool has_nonzero_digits_after(const DecimalDigits& all_digits, int kept) {
+    for (int i = kept; i < all_digits.num_digits; ++i) {
+        if (all_digits.digits[i] != 0)
+            return true;
+    }
+    return all_digits.truncated;
+}
+
+template<bool bounded>
+long long parse_fixed_point(const char* str, Bounds<bounded> bounds, char** endptr, int scale, unsigned* flags) {
+    assert(0 <= scale && scale <= FIXED_POINT_MAX_SCALE);
+    if (flags)
+        *flags = 0;
+    char* parse_ptr;
+    strtons(str, bounds, &parse_ptr);
+    const Sign sign = strtosign(parse_ptr, bounds, &parse_ptr);
+
+    MantissaState<10> mantissa{sign};
+    int exponent;
+    if (!parse_mantissa_and_exponent<10, true>(&parse_ptr, bounds, mantissa, &exponent)) {
+        if (endptr)
+            *endptr = const_cast<char*>(str);
+        return 0;
+    }
+    if (endptr)
+        *endptr = parse_ptr;
+
+    // The number is "digits * 10^exponent", and we want it times 10^scale.
+    long long value = mantissa.digits.number();
+    long long shift = static_cast<long long>(exponent) + scale;
+    bool overflow = false;
+    bool truncated = false;
+    if (mantissa.digits_overflow) {
+        // Then `exponent` counts the digits that didn't fit, and the first few
+        // of those might still end up in front of the decimal point.
+        const DecimalDigits& all_digits = *mantissa.all_digits;
+        int next = 0;
+        for (long long rest = value; rest != 0; rest /= 10)
+            next += 1;
+        while (shift > 0) {
+            const int digit = (next < all_digits.num_digits) ? all_digits.digits[next] : 0;
+            if (value > (LLONG_MAX - digit) / 10 || value < (LLONG_MIN + digit) / 10) {
+                overflow = true;
+                break;
+            }
+            value = value * 10 + (sign == Sign::Negative ? -digit : digit);
+            next += 1;
+            shift -= 1;
+        }
+        truncated = has_nonzero_digits_after(all_digits, next);
+    }
+
+    if (overflow) {
+        // Too large already, see above.
+    } else if (shift > FIXED_POINT_MAX_SCALE) {
+        overflow = value != 0;
+    } else if (shift >= 0) {
+        const long long power = INT_POWERS_OF_TEN[shift];
+        overflow = value > LLONG_MAX / power || value < LLONG_MIN / power;
+        value *= overflow ? 1 : power;
+    } else if (shift >= -FIXED_POINT_MAX_SCALE) {
+        // Division truncates towards zero, which is exactly what we want.
+        const long long power = INT_POWERS_OF_TEN[-shift];
+        truncated |= value % power != 0;
+        value /= power;
+    } else {
+        truncated |= value != 0;
+        value = 0;
+    }
+
+    if (overflow) {
+        if (flags)
+            *flags = FixedPointFlag::FixedOverflow;
+        return (sign == Sign::Negative) ? LLONG_MIN : LLONG_MAX;
+    }
+    if (flags && truncated)
+        *flags = FixedPointFlag::FixedTruncated;
+    return value;
+}
+
+// Parses a decimal number into an int64 with `scale` implied decimals, from 0 to 18.
+// `*flags` (if given) is a combination of `FixedPointFlag`s.
+long long new_strtofixed(const char* str, char** endptr, int scale, unsigned* flags) {
+    return parse_fixed_point(str, NulTerminated { nullptr }, endptr, scale, flags);
+}
+
+long long new_strtofixed(const char* first, const char* last, char** endptr, int scale, unsigned* flags) {
+    return parse_fixed_point(first, Range { last }, endptr, scale, flags);
+}
+
+// Memoizing front end for `new_strtod`, for input that repeats the same few
+// short tokens over and over, like "0", "1.0" or "-1" in logs and telemetry.
+// A token is the run of characters that `new_strtod` could possibly look at
+// (after leading whitespace): Letters, digits, '+', '-' and '.'. Whatever comes
+// after it can't change the result, so the token's bytes alone are the key.
+// Tokens that don't fit into a key go straight to `parse_strtod`.
+// The cache is direct-mapped and per thread, so there's no locking, and a
+// collision simply replaces the older entry.
+static const int STRTOD_CACHE_MAX_TOKEN = 15;
+static const int STRTOD_CACHE_BITS = 8;
+static const int STRTOD_CACHE_ENTRIES = 1 << STRTOD_CACHE_BITS;
+
+struct StrtodCacheEntry {
+    // The token, padded with NUL bytes, and its length in the last byte.
+    // All zeros means the entry is empty, since tokens are never empty.
+    uint64_t key[2];
+    double value;
+    // Zero if there's no number at all, so `endptr` has to be the original `str`.
+    int consumed;
+};
+
+struct StrtodCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    // Tokens that were empty or too long for a key.
+    uint64_t bypassed;
+};
+
+struct StrtodCache {
+    StrtodCacheEntry entries[STRTOD_CACHE_ENTRIES];
+    StrtodCacheStats stats;
+};
+
+static thread_local StrtodCache STRTOD_CACHE;
+
+ALWAYS_INLINE bool is_token_char(char ch) {
+    const uint8_t cls = char_class(ch);
+    return cls < 36 || cls == CHAR_CLASS_PUNCT;
+}
+
+template<bool bounded>
+double parse_strtod_cached(const char* str, Bounds<bounded> bounds, char** endptr) {
+    StrtodCache& cache = STRTOD_CACHE;
+    const char* token = str;
+    while (is_space(bounds.at(token)))
+        token += 1;
+    int length = 0;
+    while (length <= STRTOD_CACHE_MAX_TOKEN && is_token_char(bounds.at(token, length)))
+        length += 1;
+    if (length == 0 || length > STRTOD_CACHE_MAX_TOKEN) {
+        cache.stats.bypassed += 1;
+        return parse_strtod<DoubleFormat, StrtodPolicy>(str, bounds, endptr);
+    }
+
+    char bytes[16] = {};
+    memcpy(bytes, token, length);
+    bytes[15] = static_cast<char>(length);
+    uint64_t key[2];
+    memcpy(key, bytes, sizeof(key));
+    const uint64_t hash = (key[0] ^ (key[1] * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+    StrtodCacheEntry& entry = cache.entries[hash >> (64 - STRTOD_CACHE_BITS)];
+
+    if (entry.key[0] == key[0] && entry.key[1] == key[1]) {
+        cache.stats.hits += 1;
+    } else {
+        cache.stats.misses += 1;
+        char* token_end;
+        entry.value = parse_strtod<DoubleFormat, StrtodPolicy>(token, bounds, &token_end);
+        entry.consumed = token_end - token;
+        entry.key[0] = key[0];
+        entry.key[1] = key[1];
+    }
+    if (endptr)
+        *endptr = const_cast<char*>(entry.consumed > 0 ? token + entry.consumed : str);
+    return entry.value;
+}
+
+// Exactly the same results as `new_strtod`, just faster on repetitive input.
+double new_strtod_cached(const char* str, char** endptr) {
+    return parse_strtod_cached(str, NulTerminated { nullptr }, endptr);
+}
+
+double new_strtod_cached(const char* first, const char* last, char** endptr) {
+    return parse_strtod_cached(first, Range { last }, endptr);
+}
+
+// Statistics for the calling thread's cache, to see whether it pays off.
+StrtodCacheStats new_strtod_cache_stats() {
+    return STRTOD_CACHE.stats;
+}
+
+// Forgets all entries and statistics of the calling thread's cache.
+void new_strtod_reset_cache() {
+    memset(&STRTOD_CACHE, 0, sizeof(StrtodCache));
+}
+
+// strtol and friends, on top of `NumParser`. Same grammar and error handling as
+// the C functions: Leading whitespace, a sign, and an optional "0x" prefix for
+// base 16. Base 0 means: Figure it out from the prefix ("0x" is 16, "0" is 8).
+// On overflow, the result saturates, and errno is set to ERANGE.
+// For the unsigned variants, a minus sign negates the result (modulo 2^n).
+template<typename T, T min_value, T max_value, bool bounded>
+T parse_strtoi(const char* str, Bounds<bounded> bounds, char** endptr, int base) {
+    if (base < 0 || base == 1 || base > 36) {
+        // Like glibc, leave `*endptr` alone. C doesn't say what should happen here.
+        errno = EINVAL;
+        return 0;
+    }
+
+    char* parse_ptr;
+    strtons(str, bounds, &parse_ptr);
+    const Sign sign = strtosign(parse_ptr, bounds, &parse_ptr);
+
+    // Parse base prefix. "0x" without any hex digits is just a zero followed by garbage.
+    if ((base == 0 || base == 16) && bounds.at(parse_ptr) == '0' && (bounds.at(parse_ptr, 1) == 'x' || bounds.at(parse_ptr, 1) == 'X')
+        && digit_value(bounds.at(parse_ptr, 2), 16) != -1) {
+        parse_ptr += 2;
+        base = 16;
+    } else if (base == 0) {
+        base = (bounds.at(parse_ptr) == '0') ? 8 : 10;
+    }
+
+    // Unsigned types can't hold negative numbers, so parse the magnitude and negate it later.
+    const bool is_signed = min_value != 0;
+    NumParser<T, min_value, max_value> parser { is_signed ? sign : Sign::Positive, base };
+    const char* digits_begin = parse_ptr;
+    bool overflow = false;
+    while (true) {
+        // Fast path: Eight decimal digits at a time, until we get close to overflowing.
+        if (base == 10 && !overflow && bounds.can_load_eight_bytes(parse_ptr)) {
+            const uint64_t chunk = load_eight_bytes(parse_ptr);
+            if (is_made_of_eight_digits(chunk) && parser.consume_eight_digits(parse_eight_digits(chunk))) {
+                parse_ptr += 8;
+                continue;
+            }
+        }
+
+        if (overflow) {
+            // Still need to find the end.
+            if (parser.parse_digit(bounds.at(parse_ptr)) == -1)
+                break;
+        } else {
+            const DigitConsumeDecision decision = parser.consume(bounds.at(parse_ptr));
+            if (decision == DigitConsumeDecision::Invalid)
+                break;
+            overflow = decision != DigitConsumeDecision::Consumed;
+        }
+        parse_ptr += 1;
+    }
+
+    if (parse_ptr == digits_begin) {
+        // No actual number available.
+        if (endptr)
+            *endptr = const_cast<char*>(str);
+        return 0;
+    }
+    if (endptr)
+        *endptr = parse_ptr;
+
+    if (overflow) {
+        errno = ERANGE;
+        if (!is_signed || sign != Sign::Negative)
+            return max_value;
+        return min_value;
+    }
+    T value = parser.number();
+    if (!is_signed && sign == Sign::Negative)
+        value = -value;
+    return value;
+}
+
+long new_strtol(const char* str, char** endptr, int base) {
+    return parse_strtoi<long, LONG_MIN, LONG_MAX>(str, NulTerminated { nullptr }, endptr, base);
+}
+
+long long new_strtoll(const char* str, char** endptr, int base) {
+    return parse_strtoi<long long, LLONG_MIN, LLONG_MAX>(str, NulTerminated { nullptr }, endptr, base);
+}
+
+unsigned long new_strtoul(const char* str, char** endptr, int base) {
+    return parse_strtoi<unsigned long, 0, ULONG_MAX>(str, NulTerminated { nullptr }, endptr, base);
+}
+
+unsigned long long new_strtoull(const char* str, char** endptr, int base) {
+    return parse_strtoi<unsigned long long, 0, ULLONG_MAX>(str, NulTerminated { nullptr }, endptr, base);
+}
+
+// Shortest round-trip formatting, i.e. the other direction. This is Raffaello
+// Giulietti's Schubfach, see "The Schubfach way to render doubles" (2020).
+// The idea: The doubles that round to `value` form an interval. Scale its bounds
+// by the right power of ten (with round-to-odd, so that we can still tell exact
+// from inexact), and see whether a shorter decimal still fits in there.
+
+// floor(log10(2^q)), floor(log10(3/4 * 2^q)), and floor(log2(10^k)),
+// exact for all exponents we need.
+constexpr int floor_log10_pow2(int q) {
+    return static_cast<int>((static_cast<int64_t>(q) * 661971961083LL) >> 41);
+}
+
+constexpr int floor_log10_three_quarters_pow2(int q) {
+    return static_cast<int>((static_cast<int64_t>(q) * 661971961083LL - 274743187321LL) >> 41);
+}
+
+constexpr int floor_log2_pow10(int k) {
+    return static_cast<int>((static_cast<int64_t>(k) * 913124641741LL) >> 38);
+}
+
+// Smallest and largest `k` for which we store 10^k. That's what doubles need.
+static const int SCHUBFACH_POWER_MIN = -292;
+static const int SCHUBFACH_POWER_MAX = 324;
+static const int NUM_SCHUBFACH_POWERS = SCHUBFACH_POWER_MAX - SCHUBFACH_POWER_MIN + 1;
+static const uint64_t MASK_63 = (1ULL << 63) - 1;
+
+struct SchubfachPowers {
+    // Index `k - SCHUBFACH_POWER_MIN`. This is g = floor(10^k * 2^-r) + 1, where
+    // 2^125 <= g < 2^126. `high` has the upper 63 bits, `low` the lower 63 bits.
+    UInt128 entries[NUM_SCHUBFACH_POWERS];
+};
+
+// Sets `entry` to floor(`source` / 2^`offset`) + 1, split into 63-bit halves.
+constexpr void set_schubfach_power(UInt128& entry, const ConstexprBignum& source, int offset) {
+    const uint64_t low = (source.extract_64_bits(offset) & MASK_63) + 1;
+    entry.high = (source.extract_64_bits(offset + 63) & MASK_63) + (low >> 63);
+    entry.low = low & MASK_63;
+}
+
+constexpr SchubfachPowers generate_schubfach_powers() {
+    SchubfachPowers table {};
+
+    // Positive powers: floor(10^k / 2^r) is just a matter of picking the right bits.
+    ConstexprBignum power {};
+    power.limbs[0] = 1;
+    for (int k = 0; k <= SCHUBFACH_POWER_MAX; ++k) {
+        const int r = floor_log2_pow10(k) - 125;
+        set_schubfach_power(table.entries[k - SCHUBFACH_POWER_MIN], power, r);
+        power.multiply_small(10);
+    }
+
+    // Negative powers: Same, but `reciprocal` is floor(2^1760 / 10^-k), just
+    // like in `generate_powers_of_five`. Picking bits still rounds down.
+    ConstexprBignum reciprocal {};
+    reciprocal.limbs[CONSTEXPR_BIGNUM_LIMBS - 1] = 1;
+    for (int k = -1; k >= SCHUBFACH_POWER_MIN; --k) {
+        reciprocal.divide_small(10);
+        const int r = floor_log2_pow10(k) - 125;
+        set_schubfach_power(table.entries[k - SCHUBFACH_POWER_MIN], reciprocal, 32 * (CONSTEXPR_BIGNUM_LIMBS - 1) + r);
+    }
+
+    return table;
+}
+
+static constexpr SchubfachPowers SCHUBFACH_POWERS = generate_schubfach_powers();
+
+// Roughly g * cp / 2^127, but rounded to odd: If anything nonzero got dropped,
+// the lowest bit is set. So exact results stay distinguishable from inexact ones.
+uint64_t schubfach_round_to_odd(UInt128 g, uint64_t cp) {
+    const uint64_t x1 = full_multiplication(g.low, cp).high;
+    const UInt128 y = full_multiplication(g.high, cp);
+    const uint64_t z = (y.low >> 1) + x1;
+    const uint64_t vbp = y.high + (z >> 63);
+    return vbp | (((z & MASK_63) + MASK_63) >> 63);
+}
+
+// The decimal "digits * 10^exponent" that `schubfach_to_decimal` picked.
+struct ShortestDecimal {
+    uint64_t digits;
+    int exponent;
+};
+
+// Finds the shortest decimal that rounds to "c * 2^q", and if there are several,
+// the one closest to it.
+ShortestDecimal schubfach_to_decimal(int q, uint64_t c) {
+    const uint64_t out = c & 1;
+    const uint64_t cb = c << 2;
+    const uint64_t cbr = cb + 2;
+    uint64_t cbl;
+    int k;
+    if (c != (1ULL << DoubleFormat::mantissa_explicit_bits) || q == -1074) {
+        cbl = cb - 2;
+        k = floor_log10_pow2(q);
+    } else {
+        // At a power of two, the gap to the next smaller double is only half as large.
+        cbl = cb - 1;
+        k = floor_log10_three_quarters_pow2(q);
+    }
+    const int h = q + floor_log2_pow10(-k) + 2;
+    const UInt128 g = SCHUBFACH_POWERS.entries[-k - SCHUBFACH_POWER_MIN];
+    const uint64_t vb = schubfach_round_to_odd(g, cb << h);
+    const uint64_t vbl = schubfach_round_to_odd(g, cbl << h);
+    const uint64_t vbr = schubfach_round_to_odd(g, cbr << h);
+
+    // The interval is less than 10 units wide, so at most one multiple of ten fits.
+    // Java's version only does this for s >= 100, because it wants at least two
+    // digits. We don't, so "5e-324" instead of "4.9e-324".
+    const uint64_t s = vb >> 2;
+    if (s >= 10) {
+        // Try one digit less first. If only one of the two neighbours is
+        // inside the interval, then that's the shortest (and closest) one.
+        const uint64_t sp10 = s / 10 * 10;
+        const uint64_t tp10 = sp10 + 10;
+        const bool upin = vbl + out <= sp10 << 2;
+        const bool wpin = (tp10 << 2) + out <= vbr;
+        if (upin != wpin)
+            return ShortestDecimal { upin ? sp10 : tp10, k };
+    }
+    const uint64_t t = s + 1;
+    const bool uin = vbl + out <= s << 2;
+    const bool win = (t << 2) + out <= vbr;
+    if (uin != win)
+        return ShortestDecimal { uin ? s : t, k };
+    // Both fit, so pick the closer one, or the even one on a tie.
+    const int64_t cmp = static_cast<int64_t>(vb - ((s + t) << 1));
+    return ShortestDecimal { (cmp < 0 || (cmp == 0 && (s & 1) == 0)) ? s : t, k };
+}
+
+// "-" + 17 digits + "." + "e-324" + NUL, rounded up.
+static const int DTOA_BUFFER_SIZE = 32;
+
+// Writes the shortest string that `new_strtod` turns back into exactly `value`,
+// followed by a NUL byte, and returns its length. If there are several, it's the
+// closest one. Uses fixed notation ("0.001") unless scientific ("1e-3") is shorter.
+// `buffer` needs room for at least `DTOA_BUFFER_SIZE` bytes.
+int new_dtoa(double value, char* buffer) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    char* ptr = buffer;
+    if (bits >> 63)
+        *(ptr++) = '-';
+
+    const int biased_exponent = (bits >> DoubleFormat::mantissa_explicit_bits) & DoubleFormat::infinite_power;
+    const uint64_t fraction = bits & ((1ULL << DoubleFormat::mantissa_explicit_bits) - 1);
+    ShortestDecimal decimal;
+    if (biased_exponent == DoubleFormat::infinite_power) {
+        strcpy(ptr, fraction ? "nan" : "inf");
+        return ptr + 3 - buffer;
+    } else if (biased_exponent == 0 && fraction == 0) {
+        strcpy(ptr, "0");
+        return ptr + 1 - buffer;
+    } else if (biased_exponent == 0) {
+        decimal = schubfach_to_decimal(-1074, fraction);
+    } else {
+        const int shift = 1075 - biased_exponent;
+        const uint64_t c = (1ULL << DoubleFormat::mantissa_explicit_bits) | fraction;
+        if (0 < shift && shift <= DoubleFormat::mantissa_explicit_bits && ((c >> shift) << shift) == c) {
+            // Small integers are their own shortest representation.
+            decimal = ShortestDecimal { c >> shift, 0 };
+        } else {
+            decimal = schubfach_to_decimal(-shift, c);
+        }
+    }
+
+    while (decimal.digits % 10 == 0) {
+        decimal.digits /= 10;
+        decimal.exponent += 1;
+    }
+    char digits[20];
+    int num_digits = 0;
+    for (uint64_t rest = decimal.digits; rest != 0; rest /= 10)
+        digits[num_digits++] = '0' + rest % 10;
+    // Now `digits` holds them in reverse, and there are `point` of them before the decimal point.
+    const int point = num_digits + decimal.exponent;
+
+    int fixed_length;
+    if (decimal.exponent >= 0)
+        fixed_length = point;
+    else if (point > 0)
+        fixed_length = num_digits + 1;
+    else
+        fixed_length = 2 - point + num_digits;
+    const int scientific_exponent = point - 1;
+    const int abs_exponent = scientific_exponent < 0 ? -scientific_exponent : scientific_exponent;
+    const int scientific_length = num_digits + (num_digits > 1) + 1 + (scientific_exponent < 0)
+        + (abs_exponent >= 100 ? 3 : abs_exponent >= 10 ? 2 : 1);
+
+    if (fixed_length <= scientific_length) {
+        if (point <= 0) {
+            *(ptr++) = '0';
+            *(ptr++) = '.';
+            for (int i = point; i < 0; ++i)
+                *(ptr++) = '0';
+        }
+        for (int i = 0; i < num_digits; ++i) {
+            if (i == point && point > 0)
+                *(ptr++) = '.';
+            *(ptr++) = digits[num_digits - 1 - i];
+        }
+        for (int i = num_digits; i < point; ++i)
+            *(ptr++) = '0';
+    } else {
+        *(ptr++) = digits[num_digits - 1];
+        if (num_digits > 1) {
+            *(ptr++) = '.';
+            for (int i = num_digits - 2; i >= 0; --i)
+                *(ptr++) = digits[i];
+        }
+        *(ptr++) = 'e';
+        if (scientific_exponent < 0)
+            *(ptr++) = '-';
+        // At most three digits, see `scientific_length`.
+        if (abs_exponent >= 100)
+            *(ptr++) = '0' + abs_exponent / 100;
+        if (abs_exponent >= 10)
+            *(ptr++) = '0' + abs_exponent / 10 % 10;
+        *(ptr++) = '0' + abs_exponent % 10;
+    }
+    *ptr = '\0';
+    return ptr - buffer;
+}
+
+// Parses all numbers in `str`, which are separated by any of the characters in `delimiters`.
+// Runs of delimiters count as a single one, just like with strtok.
+// Writes at most `max_values` numbers to `values`, and returns how many were written.
+// If a field isn't entirely a number, then bit `i % 8` of `failures[i / 8]` is set,
+// and `values[i]` is whatever `new_strtod` makes of the beginning of that field.
+// Otherwise, that bit is cleared. `failures` may be NULL.
+// If `endptr` is given, it points to where parsing stopped, so the caller can resume there.
+// `num_failed` (if given) is increased by the number of fields that failed.
+template<bool bounded>
+ALWAYS_INLINE size_t strtod_batch(const char* str, Bounds<bounded> bounds, const bool* is_delimiter, double* values, size_t max_values,
+                    unsigned char* failures, char** endptr, size_t* num_failed) {
+    const char* parse_ptr = str;
+    size_t count = 0;
+    while (count < max_values) {
+        while (is_delimiter[static_cast<unsigned char>(bounds.at(parse_ptr))])
+            parse_ptr += 1;
+        if (bounds.at_end(parse_ptr))
+            break;
+
+        // Find the end of the field first: Delimiters may well be number syntax
+        // ('e', '.', 'x', ...), and the parser mustn't read across them. This way,
+        // the fields are exactly what `count_fields` sees.
+        const char* field_end = parse_ptr;
+        while (!bounds.at_end(field_end) && !is_delimiter[static_cast<unsigned char>(bounds.at(field_end))])
+            field_end += 1;
+
+        // Leading whitespace is fine, the parser skips it.
+        char* number_end = const_cast<char*>(parse_ptr);
+        values[count] = parse_strtod<DoubleFormat, StrtodPolicy>(parse_ptr, Range { field_end }, &number_end);
+        // Anything left over is trailing garbage.
+        const bool failed = number_end != field_end;
+        parse_ptr = field_end;
+
+        if (failures) {
+            const unsigned char bit = 1 << (count % 8);
+            if (failed) {
+                failures[count / 8] |= bit;
+            } else {
+                failures[count / 8] &= ~bit;
+            }
+        }
+        if (num_failed && failed)
+            *num_failed += 1;
+        count += 1;
+    }
+
+    if (endptr)
+        *endptr = const_cast<char*>(parse_ptr);
+    return count;
+}
+
+void fill_delimiter_table(const char* delimiters, bool* is_delimiter) {
+    for (size_t i = 0; i < 256; ++i)
+        is_delimiter[i] = false;
+    for (const char* d = delimiters; *d; ++d)
+        is_delimiter[static_cast<unsigned char>(*d)] = true;
+}
+
+// How many fields `new_strtod_batch` would see in [first, last).
+size_t count_fields(const char* first, const char* last, const bool* is_delimiter) {
+    size_t count = 0;
+    bool in_field = false;
+    for (const char* ptr = first; ptr < last; ++ptr) {
+        const bool delimiter = is_delimiter[static_cast<unsigned char>(*ptr)];
+        count += (!delimiter && !in_field) ? 1 : 0;
+        in_field = !delimiter;
+    }
+    return count;
+}
+
+// Runtime CPU dispatch. We ship one binary to all kinds of machines, so we can't
+// just compile with -mavx2. Instead, the bulk kernels exist once per instruction
+// set, and we pick the best one that the CPU supports once, at startup.
+// Single numbers (`new_strtod`) always use the scalar code: An indirect call per
+// number would cost more than any of this can save.
+// Set MYSTRTOD_KERNEL to "scalar", "sse4.1", "avx2" or "avx512" to force one.
+enum StrtodKernel {
+    Scalar,
+    Sse41,
+    Avx2,
+    Avx512,
+};
+
+static const int NUM_STRTOD_KERNELS = 4;
+static const char* STRTOD_KERNEL_NAMES[NUM_STRTOD_KERNELS] = { "scalar", "sse4.1", "avx2", "avx512" };
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS 1
+#else
+#define HAVE_X86_KERNELS 0
+#endif
+
+#if HAVE_X86_KERNELS
+// Classifying bytes as delimiters, 16 to 64 at a time: Split each byte into its
+// nibbles, and look up the low nibble in a table of which high nibbles are a
+// delimiter with that low nibble. That's two tables (high nibble 0-7 or 8-15),
+// each with one bit per high nibble. This works for any set of delimiters.
+struct DelimiterNibbles {
+    alignas(16) uint8_t rows_below_0x80[16];
+    alignas(16) uint8_t rows_above_0x80[16];
+};
+
+alignas(16) static const uint8_t HIGH_NIBBLE_BITS[16] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+};
+
+DelimiterNibbles make_delimiter_nibbles(const bool* is_delimiter) {
+    DelimiterNibbles nibbles {};
+    for (int byte = 0; byte < 256; ++byte) {
+        if (!is_delimiter[byte])
+            continue;
+        uint8_t* rows = (byte < 0x80) ? nibbles.rows_below_0x80 : nibbles.rows_above_0x80;
+        rows[byte & 0x0F] |= HIGH_NIBBLE_BITS[byte >> 4];
+    }
+    return nibbles;
+}
+
+// Continues `count_fields` after the vectorized part.
+ALWAYS_INLINE size_t count_fields_tail(const char* first, const char* last, const bool* is_delimiter, bool in_field) {
+    size_t count = 0;
+    for (const char* ptr = first; ptr < last; ++ptr) {
+        const bool delimiter = is_delimiter[static_cast<unsigned char>(*ptr)];
+        count += (!delimiter && !in_field) ? 1 : 0;
+        in_field = !delimiter;
+    }
+    return count;
+}
+
+// A field starts wherever a non-delimiter follows a delimiter (or the start).
+// `delimiters` has one bit per byte, and `preceded` says whether the byte before
+// the block was a delimiter.
+ALWAYS_INLINE size_t count_field_starts(uint64_t delimiters, uint64_t all_bytes, bool preceded) {
+    const uint64_t starts = ~delimiters & ((delimiters << 1) | (preceded ? 1 : 0)) & all_bytes;
+    return __builtin_popcountll(starts);
+}
+
+__attribute__((target("sse4.1,popcnt")))
+size_t count_fields_sse41(const char* first, const char* last, const bool* is_delimiter) {
+    const DelimiterNibbles nibbles = make_delimiter_nibbles(is_delimiter);
+    const __m128i below = _mm_load_si128(reinterpret_cast<const __m128i*>(nibbles.rows_below_0x80));
+    const __m128i above = _mm_load_si128(reinterpret_cast<const __m128i*>(nibbles.rows_above_0x80));
+    const __m128i high_bits = _mm_load_si128(reinterpret_cast<const __m128i*>(HIGH_NIBBLE_BITS));
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    size_t count = 0;
+    bool preceded = true;
+    const char* ptr = first;
+    for (; last - ptr >= 16; ptr += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        const __m128i low = _mm_and_si128(bytes, low_mask);
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_mask);
+        // The top bit of each byte picks the table.
+        const __m128i rows = _mm_blendv_epi8(_mm_shuffle_epi8(below, low), _mm_shuffle_epi8(above, low), bytes);
+        const __m128i hits = _mm_and_si128(rows, _mm_shuffle_epi8(high_bits, high));
+        const uint64_t delimiters = ~_mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128())) & 0xFFFFULL;
+        count += count_field_starts(delimiters, 0xFFFFULL, preceded);
+        preceded = (delimiters >> 15) & 1;
+    }
+    return count + count_fields_tail(ptr, last, is_delimiter, !preceded);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t count_fields_avx2(const char* first, const char* last, const bool* is_delimiter) {
+    const DelimiterNibbles nibbles = make_delimiter_nibbles(is_delimiter);
+    // vpshufb only looks within each 128-bit lane, so both lanes get the whole table.
+    const __m256i below = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(nibbles.rows_below_0x80)));
+    const __m256i above = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(nibbles.rows_above_0x80)));
+    const __m256i high_bits = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(HIGH_NIBBLE_BITS)));
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    size_t count = 0;
+    bool preceded = true;
+    const char* ptr = first;
+    for (; last - ptr >= 32; ptr += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+        const __m256i low = _mm256_and_si256(bytes, low_mask);
+        const __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_mask);
+        const __m256i rows = _mm256_blendv_epi8(_mm256_shuffle_epi8(below, low), _mm256_shuffle_epi8(above, low), bytes);
+        const __m256i hits = _mm256_and_si256(rows, _mm256_shuffle_epi8(high_bits, high));
+        const uint32_t non_delimiters = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, _mm256_setzero_si256()));
+        const uint64_t delimiters = ~non_delimiters & 0xFFFFFFFFULL;
+        count += count_field_starts(delimiters, 0xFFFFFFFFULL, preceded);
+        preceded = (delimiters >> 31) & 1;
+    }
+    return count + count_fields_tail(ptr, last, is_delimiter, !preceded);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+size_t count_fields_avx512(const char* first, const char* last, const bool* is_delimiter) {
+    const DelimiterNibbles nibbles = make_delimiter_nibbles(is_delimiter);
+    // One copy per 128-bit lane. (GCC warns about _mm512_broadcast_i32x4, for no good reason.)
+    alignas(64) uint8_t tables[3][64];
+    for (int lane = 0; lane < 4; ++lane) {
+        memcpy(&tables[0][16 * lane], nibbles.rows_below_0x80, 16);
+        memcpy(&tables[1][16 * lane], nibbles.rows_above_0x80, 16);
+        memcpy(&tables[2][16 * lane], HIGH_NIBBLE_BITS, 16);
+    }
+    const __m512i below = _mm512_load_si512(tables[0]);
+    const __m512i above = _mm512_load_si512(tables[1]);
+    const __m512i high_bits = _mm512_load_si512(tables[2]);
+    const __m512i low_mask = _mm512_set1_epi8(0x0F);
+    size_t count = 0;
+    bool preceded = true;
+    const char* ptr = first;
+    for (; last - ptr >= 64; ptr += 64) {
+        const __m512i bytes = _mm512_loadu_si512(ptr);
+        const __m512i low = _mm512_and_si512(bytes, low_mask);
+        const __m512i high = _mm512_and_si512(_mm512_srli_epi16(bytes, 4), low_mask);
+        const __m512i rows = _mm512_mask_blend_epi8(_mm512_movepi8_mask(bytes),
+                                                    _mm512_shuffle_epi8(below, low), _mm512_shuffle_epi8(above, low));
+        const uint64_t delimiters = _mm512_test_epi8_mask(rows, _mm512_shuffle_epi8(high_bits, high));
+        count += count_field_starts(delimiters, ~0ULL, preceded);
+        preceded = delimiters >> 63;
+    }
+    return count + count_fields_tail(ptr, last, is_delimiter, !preceded);
+}
+
+// The number parsing itself is the same code for every kernel, just compiled
+// for the wider instruction set. The compiler gets to use it where it sees fit.
+template<bool bounded>
+__attribute__((target("sse4.1,popcnt")))
+size_t strtod_batch_sse41(const char* str, Bounds<bounded> bounds, const bool* is_delimiter, double* values, size_t max_values,
+                          unsigned char* failures, char** endptr, size_t* num_failed) {
+    return strtod_batch(str, bounds, is_delimiter, values, max_values, failures, endptr, num_failed);
+}
+
+template<bool bounded>
+__attribute__((target("avx2,bmi,bmi2,popcnt")))
+size_t strtod_batch_avx2(const char* str, Bounds<bounded> bounds, const bool* is_delimiter, double* values, size_t max_values,
+                         unsigned char* failures, char** endptr, size_t* num_failed) {
+    return strtod_batch(str, bounds, is_delimiter, values, max_values, failures, endptr, num_failed);
+}
+
+template<bool bounded>
+__attribute__((target("avx512f,avx512bw,bmi,bmi2,popcnt")))
+size_t strtod_batch_avx512(const char* str, Bounds<bounded> bounds, const bool* is_delimiter, double* values, size_t max_values,
+                           unsigned char* failures, char** endptr, size_t* num_failed) {
+    return strtod_batch(str, bounds, is_delimiter, values, max_values, failures, endptr, num_failed);
+}
+#endif
+
+template<bool bounded>
+size_t strtod_batch_scalar(const char* str, Bounds<bounded> bounds, const bool* is_delimiter, double* values, size_t max_values,
+                           unsigned char* failures, char** endptr, size_t* num_failed) {
+    return strtod_batch(str, bounds, is_delimiter, values, max_values, failures, endptr, num_failed);
+}
+
+struct StrtodKernelTable {
+    size_t (*count_fields)(const char* first, const char* last, const bool* is_delimiter);
+    size_t (*batch)(const char* str, NulTerminated bounds, const bool* is_delimiter, double* values, size_t max_values,
+                    unsigned char* failures, char** endptr, size_t* num_failed);
+    size_t (*batch_range)(const char* str, Range bounds, const bool* is_delimiter, double* values, size_t max_values,
+                          unsigned char* failures, char** endptr, size_t* num_failed);
+};
+
+// Index `StrtodKernel`. Without x86, they're all scalar, but never selected either.
+static const StrtodKernelTable STRTOD_KERNEL_TABLES[NUM_STRTOD_KERNELS] = {
+    { count_fields, strtod_batch_scalar<false>, strtod_batch_scalar<true> },
+#if HAVE_X86_KERNELS
+    { count_fields_sse41, strtod_batch_sse41<false>, strtod_batch_sse41<true> },
+    { count_fields_avx2, strtod_batch_avx2<false>, strtod_batch_avx2<true> },
+    { count_fields_avx512, strtod_batch_avx512<false>, strtod_batch_avx512<true> },
+#else
+    { count_fields, strtod_batch_scalar<false>, strtod_batch_scalar<true> },
+    { count_fields, strtod_batch_scalar<false>, strtod_batch_scalar<true> },
+    { count_fields, strtod_batch_scalar<false>, strtod_batch_scalar<true> },
+#endif
+};
+
+bool strtod_kernel_supported(StrtodKernel kernel) {
+#if HAVE_X86_KERNELS
+    // Might run before libgcc's own constructor did this.
+    __builtin_cpu_init();
+    switch (kernel) {
+    case StrtodKernel::Scalar:
+        return true;
+    case StrtodKernel::Sse41:
+        return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt");
+    case StrtodKernel::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")
+            && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+    case StrtodKernel::Avx512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+    }
+    return false;
+#else
+    return kernel == StrtodKernel::Scalar;
+#endif
+}
+
+StrtodKernel detect_strtod_kernel() {
+    const char* forced = getenv("MYSTRTOD_KERNEL");
+    if (forced) {
+        for (int i = 0; i < NUM_STRTOD_KERNELS; ++i) {
+            if (strcmp(forced, STRTOD_KERNEL_NAMES[i]) == 0 && strtod_kernel_supported(static_cast<StrtodKernel>(i)))
+                return static_cast<StrtodKernel>(i);
+        }
+        // Unknown or unsupported: Better to be slow than to crash.
+        return StrtodKernel::Scalar;
+    }
+    for (int i = NUM_STRTOD_KERNELS - 1; i > 0; --i) {
+        if (strtod_kernel_supported(static_cast<StrtodKernel>(i)))
+            return static_cast<StrtodKernel>(i);
+    }
+    return StrtodKernel::Scalar;
+}
+
+static StrtodKernel ACTIVE_STRTOD_KERNEL = detect_strtod_kernel();
+
+StrtodKernel new_strtod_active_kernel() {
+    return ACTIVE_STRTOD_KERNEL;
+}
+
+// For tests and benchmarks. Returns false (and changes nothing) if the CPU can't
+// run `kernel`. Don't call this while other threads are parsing.
+bool new_strtod_force_kernel(StrtodKernel kernel) {
+    if (!strtod_kernel_supported(kernel))
+        return false;
+    ACTIVE_STRTOD_KERNEL = kernel;
+    return true;
+}
+
+size_t new_strtod_batch(const char* str, const char* delimiters, double* values, size_t max_values,
+                        unsigned char* failures, char** endptr) {
+    // Setup happens only once, not per number.
+    bool is_delimiter[256];
+    fill_delimiter_table(delimiters, is_delimiter);
+    return STRTOD_KERNEL_TABLES[ACTIVE_STRTOD_KERNEL].batch(str, NulTerminated { nullptr }, is_delimiter, values, max_values, failures, endptr, nullptr);
+}
+
+// Files smaller than this per thread aren't worth starting another thread for.
+static const size_t FILE_MIN_BYTES_PER_THREAD = 64 * 1024;
+
+// One thread's share of the file. Always starts and ends at a delimiter
+// (or the start/end of the file), so no field is split between two threads.
+struct FileRange {
+    const char* first;
+    const char* last;
+    size_t num_fields;
+    size_t first_index;
+    size_t num_failed;
+    bool complete;
+};
+
+// Runs `work(range)` for every range, each on its own thread, and waits for all of them.
+// Returns false (and sets errno) if not all threads could be started. The ones that
+// did start are still waited for, since they use the ranges.
+template<typename Work>
+bool run_on_file_ranges(std::vector<FileRange>& ranges, Work work) {
+    std::vector<std::thread> threads;
+    bool started = true;
+    try {
+        threads.reserve(ranges.size());
+        for (FileRange& range : ranges)
+            threads.emplace_back(work, &range);
+    } catch (const std::system_error& error) {
+        errno = error.code().value();
+        started = false;
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        started = false;
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    return started;
+}
+
+// Parses a whole file of numbers separated by `delimiters`, using `num_threads`
+// threads (0 means one per core). Each field means the same as for `new_strtod_batch`,
+// but the input doesn't need to end in a NUL byte. It is mapped all at once,
+// though, so it must fit into the address space: On a 32-bit machine, files of
+// a few GB fail with EFBIG or ENOMEM.
+// On success, `*values` is a malloc'ed array of `*count` numbers (in file order),
+// and `*num_failed` (if given) is how many fields weren't entirely a number.
+// On failure, returns false and leaves errno set.
+//
+// The file is memory-mapped and split into one range per thread, each ending
+// at a delimiter. A first pass counts the fields in each range, so that the
+// second pass can parse every range directly into its part of the output.
+bool new_strtod_file(const char* path, const char* delimiters, unsigned num_threads,
+                     double** values, size_t* count, size_t* num_failed) {
+    assert(values && count);
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    if (static_cast<unsigned long long>(info.st_size) > static_cast<size_t>(-1)) {
+        // Doesn't fit into our address space anyway.
+        close(fd);
+        errno = EFBIG;
+        return false;
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+
+    const char* data = nullptr;
+    if (size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        // We read the whole file from front to back, twice.
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    // The mapping stays valid without the file descriptor.
+    close(fd);
+
+    bool is_delimiter[256];
+    fill_delimiter_table(delimiters, is_delimiter);
+
+    if (num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0)
+        num_threads = 1;
+    if (num_threads > size / FILE_MIN_BYTES_PER_THREAD + 1)
+        num_threads = size / FILE_MIN_BYTES_PER_THREAD + 1;
+
+    // Split roughly evenly, then move each boundary forward to the next delimiter.
+    std::vector<FileRange> ranges(num_threads);
+    const char* end = data + size;
+    const char* boundary = data;
+    for (unsigned i = 0; i < num_threads; ++i) {
+        ranges[i].first = boundary;
+        boundary = (i + 1 == num_threads) ? end : data + (size / num_threads) * (i + 1);
+        if (boundary < ranges[i].first)
+            boundary = ranges[i].first;
+        while (boundary < end && !is_delimiter[static_cast<unsigned char>(*boundary)])
+            boundary += 1;
+        ranges[i].last = boundary;
+        ranges[i].num_failed = 0;
+        ranges[i].complete = false;
+    }
+
+    const StrtodKernelTable& kernels = STRTOD_KERNEL_TABLES[ACTIVE_STRTOD_KERNEL];
+    const bool counted = run_on_file_ranges(ranges, [&is_delimiter, &kernels](FileRange* range) {
+        range->num_fields = kernels.count_fields(range->first, range->last, is_delimiter);
+    });
+    if (!counted) {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+        return false;
+    }
+
+    size_t total = 0;
+    for (FileRange& range : ranges) {
+        range.first_index = total;
+        total += range.num_fields;
+    }
+    double* output = static_cast<double*>(malloc(total > 0 ? total * sizeof(double) : 1));
+    if (!output) {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+        errno = ENOMEM;
+        return false;
+    }
+
+    const bool parsed_all = run_on_file_ranges(ranges, [output, &is_delimiter, &kernels](FileRange* range) {
+        const size_t parsed = kernels.batch_range(range->first, Range { range->last }, is_delimiter,
+                                                  output + range->first_index, range->num_fields,
+                                                  nullptr, nullptr, &range->num_failed);
+        // Both passes split at exactly the same bytes, so this can't happen. But if it
+        // ever does, some values were never written, and we must not hand those out.
+        range->complete = parsed == range->num_fields;
+    });
+
+    if (data)
+        munmap(const_cast<char*>(data), size);
+    if (!parsed_all) {
+        free(output);
+        return false;
+    }
+    for (const FileRange& range : ranges) {
+        if (!range.complete) {
+            free(output);
+            errno = EIO;
+            return false;
+        }
+    }
+
+    *values = output;
+    *count = total;
+    if (num_failed) {
+        *num_failed = 0;
+        for (const FileRange& range : ranges)
+            *num_failed += range.num_failed;
+    }
+    return true;
+}
+
+// Called for every field that a `StreamingStrtod` finishes.
+// `failed` means the same as for `new_strtod_batch`.
+typedef void (*number_sink_t)(void* context, double value, bool failed);
+
+// Parses numbers from input that arrives in pieces, e.g. from fixed-size reads.
+// Fields are separated by delimiters, just like for `new_strtod_batch`, and each
+// field means exactly what `new_strtod` would make of it. A number may be split
+// across chunks at any point: In between, we keep the same state that
+// `parse_strtod` keeps on its stack, so nothing is copied or scanned twice.
+class StreamingStrtod {
+public:
+    StreamingStrtod(const char* delimiters, number_sink_t sink, void* context)
+        : m_sink(sink)
+        , m_context(context)
+        , m_mantissa{Sign::Positive, 10}
+        , m_hex_mantissa{Sign::Positive}
+        , m_exponent{Sign::Positive}
+    {
+        for (size_t i = 0; i < 256; ++i)
+            m_is_delimiter[i] = false;
+        for (const char* d = delimiters; *d; ++d)
+            m_is_delimiter[static_cast<unsigned char>(*d)] = true;
+        // The eight-digit fast path doesn't look at delimiters at all.
+        m_fast_digits = true;
+        for (char digit = '0'; digit <= '9'; ++digit)
+            m_fast_digits &= !m_is_delimiter[static_cast<unsigned char>(digit)];
+    }
+
+    // `m_mantissa.all_digits` points into this very object, so a copy would point into the original.
+    StreamingStrtod(const StreamingStrtod&) = delete;
+    StreamingStrtod& operator=(const StreamingStrtod&) = delete;
+
+    void feed(const char* chunk, size_t length) {
+        const char* ptr = chunk;
+        const char* end = chunk + length;
+        while (ptr < end) {
+            if (m_fast_digits && m_state == State::Mantissa && m_base == 10) {
+                while (end - ptr >= 8 && m_mantissa.consume_eight_digits(load_eight_bytes(ptr)))
+                    ptr += 8;
+                if (ptr == end)
+                    break;
+            }
+            step(*ptr);
+            ptr += 1;
+        }
+    }
+
+    // Signals the end of the input, which also ends the last field (if any).
+    void finish() {
+        if (m_state != State::BetweenFields)
+            emit();
+    }
+
+private:
+    enum State {
+        BetweenFields,
+        LeadingSpace,
+        AfterSign,
+        Special,
+        LeadingZero,
+        Mantissa,
+        ExponentMarker,
+        ExponentSign,
+        ExponentDigits,
+        // The field doesn't continue the number; wait for the next delimiter.
+        Garbage,
+    };
+
+    void step(char ch) {
+        if (m_is_delimiter[static_cast<unsigned char>(ch)]) {
+            if (m_state != State::BetweenFields)
+                emit();
+            return;
+        }
+
+        switch (m_state) {
+        case State::BetweenFields:
+            m_state = State::LeadingSpace;
+            m_sign = Sign::Positive;
+            m_base = 10;
+            // fallthrough
+        case State::LeadingSpace:
+            if (is_space(ch))
+                return;
+            if (ch == '+' || ch == '-') {
+                m_sign = (ch == '-') ? Sign::Negative : Sign::Positive;
+                m_state = State::AfterSign;
+                return;
+            }
+            // fallthrough
+        case State::AfterSign:
+            if (ch == 'i' || ch == 'I') {
+                m_special_upper = "INFINITY";
+                m_special_lower = "infinity";
+                m_special_matched = 1;
+                m_state = State::Special;
+                return;
+            }
+            if (ch == 'n' || ch == 'N') {
+                m_special_upper = "NAN";
+                m_special_lower = "nan";
+                m_special_matched = 1;
+                m_state = State::Special;
+                return;
+            }
+            m_mantissa = MantissaState<>{m_sign, 10};
+            // Can't use `DECIMAL_ARENA`: Someone might parse something else between two chunks.
+            m_mantissa.all_digits = &m_all_digits;
+            m_state = (ch == '0') ? State::LeadingZero : State::Mantissa;
+            if (!m_mantissa.consume(ch))
+                become_garbage();
+            return;
+        case State::Special: {
+            const char upper = m_special_upper[m_special_matched];
+            const char lower = m_special_lower[m_special_matched];
+            if (upper != '\0' && (ch == upper || ch == lower)) {
+                m_special_matched += 1;
+            } else {
+                become_garbage();
+            }
+            return;
+        }
+        case State::LeadingZero:
+            m_state = State::Mantissa;
+            if (ch == 'x' || ch == 'X') {
+                m_base = 16;
+                m_hex_mantissa = HexMantissaState{m_sign};
+                return;
+            }
+            // fallthrough
+        case State::Mantissa:
+            if (m_base == 16 ? m_hex_mantissa.consume(ch) : m_mantissa.consume(ch))
+                return;
+            if (mantissa_usable() && is_exponent_marker(ch, m_base)) {
+                m_state = State::ExponentMarker;
+            } else {
+                become_garbage();
+            }
+            return;
+        case State::ExponentMarker:
+            if (ch == '+' || ch == '-') {
+                m_exponent = ExponentState<10>{(ch == '-') ? Sign::Negative : Sign::Positive};
+                m_state = State::ExponentSign;
+                return;
+            }
+            m_exponent = ExponentState<10>{Sign::Positive};
+            // fallthrough
+        case State::ExponentSign:
+            if (m_exponent.consume(ch)) {
+                m_state = State::ExponentDigits;
+            } else {
+                become_garbage();
+            }
+            return;
+        case State::ExponentDigits:
+            if (!m_exponent.consume(ch))
+                become_garbage();
+            return;
+        case State::Garbage:
+            return;
+        default:
+            assert(false); // ASSERT_NOT_REACHED();
+        }
+    }
+
+    // What `new_strtod` would return if the field ended right here,
+    // and whether it would have consumed the entire field.
+    double current_value(bool* failed) const {
+        *failed = false;
+        switch (m_state) {
+        case State::Special:
+            if (m_special_upper[0] == 'I' && m_special_matched >= 3) {
+                *failed = m_special_matched != 3 && m_special_matched != 8;
+                return infinity_value<DoubleFormat>(m_sign);
+            }
+            if (m_special_upper[0] == 'N' && m_special_matched == 3)
+                return nan_value<DoubleFormat>(m_sign);
+            break;
+        case State::LeadingZero:
+        case State::Mantissa:
+            if (mantissa_usable())
+                return mantissa_value(mantissa_exponent());
+            if (m_base == 16) {
+                // Just "0x", which `parse_strtod` reads as a zero followed by garbage.
+                *failed = true;
+                return m_sign != Sign::Negative ? 0.0 : -0.0;
+            }
+            break;
+        case State::ExponentMarker:
+        case State::ExponentSign:
+            // Rolled back, just like `parse_strtod` does.
+            *failed = true;
+            return mantissa_value(mantissa_exponent());
+        case State::ExponentDigits:
+            return mantissa_value(m_exponent.apply_to(mantissa_exponent()));
+        case State::Garbage:
+            *failed = true;
+            return m_garbage_value;
+        default:
+            break;
+        }
+        // No actual number value available.
+        *failed = true;
+        return 0.0;
+    }
+
+    bool mantissa_usable() const {
+        return m_base == 16 ? m_hex_mantissa.digits_usable : m_mantissa.digits_usable;
+    }
+
+    int mantissa_exponent() const {
+        return m_base == 16 ? m_hex_mantissa.exponent : m_mantissa.exponent;
+    }
+
+    double mantissa_value(int exponent) const {
+        if (m_base == 16)
+            return m_hex_mantissa.to_value<DoubleFormat>(m_sign, exponent);
+        return m_mantissa.to_value<DoubleFormat>(m_sign, exponent);
+    }
+
+    void become_garbage() {
+        bool ignored;
+        m_garbage_value = current_value(&ignored);
+        m_state = State::Garbage;
+    }
+
+    void emit() {
+        bool failed;
+        const double value = current_value(&failed);
+        m_sink(m_context, value, failed);
+        m_state = State::BetweenFields;
+    }
+
+    bool m_is_delimiter[256];
+    bool m_fast_digits;
+    number_sink_t m_sink;
+    void* m_context;
+
+    State m_state { State::BetweenFields };
+    Sign m_sign { Sign::Positive };
+    int m_base { 10 };
+    MantissaState<> m_mantissa;
+    DecimalDigits m_all_digits;
+    HexMantissaState m_hex_mantissa;
+    ExponentState<10> m_exponent;
+    const char* m_special_upper { nullptr };
+    const char* m_special_lower { nullptr };
+    int m_special_matched { 0 };
+    double m_garbage_value { 0.0 };
+};
+
+// Pipelined loading for input that can't be mmapped, like stdin or a pipe from
+// a decompressor: A reader thread keeps filling a ring of buffers, while the
+// calling thread feeds the filled ones to a `StreamingStrtod`. So reading and
+// parsing overlap, and numbers that straddle two buffers are no problem at all.
+static const size_t PIPE_BUFFER_SIZE = 64 * 1024;
+static const size_t PIPE_NUM_BUFFERS = 4;
+
+struct PipeBuffer {
+    char data[PIPE_BUFFER_SIZE];
+    size_t length;
+};
+
+// Parses everything from `fd` until EOF, and hands each field to `sink`, in order.
+// On a read error, returns false and leaves errno set. All fields before the
+// error have been delivered by then, but not the one it interrupted.
+bool new_strtod_fd(int fd, const char* delimiters, number_sink_t sink, void* context) {
+    std::vector<PipeBuffer> buffers(PIPE_NUM_BUFFERS);
+    std::mutex mutex;
+    std::condition_variable filled_cv;
+    std::condition_variable emptied_cv;
+    // Both only ever grow, and buffer `i` lives in `buffers[i % PIPE_NUM_BUFFERS]`.
+    size_t num_filled = 0;
+    size_t num_emptied = 0;
+    bool reader_done = false;
+    int read_errno = 0;
+
+    auto read_all = [&]() {
+        for (size_t i = 0;; ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                emptied_cv.wait(lock, [&]() { return i - num_emptied < PIPE_NUM_BUFFERS; });
+            }
+            PipeBuffer& buffer = buffers[i % PIPE_NUM_BUFFERS];
+            ssize_t length;
+            do {
+                length = read(fd, buffer.data, PIPE_BUFFER_SIZE);
+            } while (length < 0 && errno == EINTR);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (length <= 0) {
+                read_errno = (length < 0) ? errno : 0;
+                reader_done = true;
+                filled_cv.notify_one();
+                return;
+            }
+            buffer.length = static_cast<size_t>(length);
+            num_filled += 1;
+            filled_cv.notify_one();
+        }
+    };
+    std::thread reader;
+    try {
+        reader = std::thread(read_all);
+    } catch (const std::system_error& error) {
+        // Like everything else here, report it through errno.
+        errno = error.code().value();
+        return false;
+    }
+
+    StreamingStrtod stream { delimiters, sink, context };
+    for (size_t i = 0;; ++i) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            filled_cv.wait(lock, [&]() { return num_filled > i || reader_done; });
+            if (num_filled == i)
+                break;
+        }
+        const PipeBuffer& buffer = buffers[i % PIPE_NUM_BUFFERS];
+        stream.feed(buffer.data, buffer.length);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            num_emptied += 1;
+        }
+        emptied_cv.notify_one();
+    }
+    reader.join();
+
+    if (read_errno != 0) {
+        errno = read_errno;
+        return false;
+    }
+    stream.finish();
+    return true;
+}
+
+// Columnar CSV loading: Each column becomes one contiguous array of its own
+// type, instead of one struct per row. The type of each column is inferred from
+// the first `CSV_SAMPLE_ROWS` rows: int64 if every non-empty field there is a
+// decimal integer that fits, double if every one is a number, and text otherwise.
+// Numeric fields are parsed straight out of the input, and the parser's end
+// is where we look for the delimiter, so nothing is copied or scanned twice.
+//
+// Rows end at '\n' (with an optional '\r'), and blank lines are skipped. A field
+// in double quotes may contain delimiters and newlines; a pair of quotes inside
+// stands for one quote. Quoted fields are always text, though. Leading and
+// trailing whitespace around numbers is fine.
+// The first line decides the number of columns. Missing fields are invalid,
+// surplus fields are ignored.
+static const size_t CSV_SAMPLE_ROWS = 64;
+
+enum CsvColumnType {
+    Int64,
+    Double,
+    Text,
+};
+
+// Points into the input, which therefore has to outlive the `CsvTable`.
+// For quoted fields, this is what's inside the quotes, so doubled quotes stay doubled.
+struct CsvField {
+    const char* first;
+    const char* last;
+};
+
+struct CsvColumn {
+    CsvColumnType type;
+    // Empty unless there was a header.
+    CsvField name;
+    // Only the one for `type` is filled, with an entry for each row.
+    std::vector<long long> ints;
+    std::vector<double> doubles;
+    std::vector<CsvField> texts;
+    // Bit `i % 8` of `invalid[i / 8]` is set if row `i` is empty, or not entirely of
+    // this type. Then the value is 0, or whatever `new_strtod` made of it.
+    std::vector<unsigned char> invalid;
+    size_t num_invalid;
+};
+
+struct CsvTable {
+    std::vector<CsvColumn> columns;
+    size_t num_rows;
+};
+
+ALWAYS_INLINE bool is_csv_field_end(const char* ptr, const char* last, char delimiter) {
+    return ptr == last || *ptr == delimiter || *ptr == '\n';
+}
+
+// Reads the field at `*ptr` as text, and moves `*ptr` to its end (the delimiter,
+// newline, or `last`). Returns whether the field was quoted.
+bool read_csv_text(const char** ptr, const char* last, char delimiter, CsvField* field) {
+    const char* parse_ptr = *ptr;
+    bool quoted = parse_ptr < last && *parse_ptr == '"';
+    if (quoted) {
+        parse_ptr += 1;
+        field->first = parse_ptr;
+        while (parse_ptr < last && (*parse_ptr != '"' || (last - parse_ptr >= 2 && parse_ptr[1] == '"')))
+            parse_ptr += (*parse_ptr == '"') ? 2 : 1;
+        field->last = parse_ptr;
+        if (parse_ptr < last)
+            parse_ptr += 1;
+    } else {
+        field->first = parse_ptr;
+    }
+    // Anything after the closing quote is silently dropped.
+    while (!is_csv_field_end(parse_ptr, last, delimiter))
+        parse_ptr += 1;
+    if (!quoted) {
+        field->last = parse_ptr;
+        if (field->last > field->first && field->last[-1] == '\r' && (parse_ptr == last || *parse_ptr == '\n'))
+            field->last -= 1;
+    }
+    *ptr = parse_ptr;
+    return quoted;
+}
+
+// Parses the field at `*ptr` as `type`, and moves `*ptr` to its end.
+// Returns whether the field was entirely of that type (and not empty).
+ALWAYS_INLINE bool read_csv_number(const char** ptr, const char* last, char delimiter, CsvColumnType type,
+                                   long long* int_value, double* double_value) {
+    // Skip leading whitespace here: The parsers would happily skip a tab
+    // delimiter, or the end of the line, and take the next field instead.
+    const char* first = *ptr;
+    while (first < last && is_space(*first) && *first != delimiter && *first != '\n')
+        first += 1;
+    // The delimiter might also be part of a number ('.', 'e', '-', ...),
+    // so the parsers mustn't read past the end of the field.
+    const char* field_end = first;
+    while (!is_csv_field_end(field_end, last, delimiter))
+        field_end += 1;
+    char* end = const_cast<char*>(first);
+    bool overflow = false;
+    if (!is_csv_field_end(first, last, delimiter) && *first != '"') {
+        if (type == CsvColumnType::Int64) {
+            // Decimal only: "010" in a spreadsheet is ten, not eight.
+            const int saved_errno = errno;
+            errno = 0;
+            *int_value = parse_strtoi<long long, LLONG_MIN, LLONG_MAX>(first, Range { field_end }, &end, 10);
+            overflow = errno == ERANGE;
+            errno = saved_errno;
+        } else {
+            *double_value = parse_strtod<DoubleFormat, StrtodPolicy>(first, Range { field_end }, &end);
+        }
+    }
+    bool valid = end != first && !overflow;
+    // Trailing whitespace (including the '\r' of "\r\n") is fine, anything else isn't.
+    while (end < last && is_space(*end) && *end != delimiter && *end != '\n')
+        end += 1;
+    if (!is_csv_field_end(end, last, delimiter)) {
+        valid = false;
+        const char* rest = end;
+        CsvField ignored;
+        // Might be quoted, so the text reader has to find the end.
+        read_csv_text(&rest, last, delimiter, &ignored);
+        end = const_cast<char*>(rest);
+    }
+    *ptr = end;
+    return valid;
+}
+
+// Skips blank lines, and returns whether there's another row.
+bool skip_blank_csv_lines(const char** ptr, const char* last) {
+    const char* parse_ptr = *ptr;
+    while (parse_ptr < last && (*parse_ptr == '\n' || (*parse_ptr == '\r' && last - parse_ptr >= 2 && parse_ptr[1] == '\n')))
+        parse_ptr += (*parse_ptr == '\n') ? 1 : 2;
+    *ptr = parse_ptr;
+    return parse_ptr < last;
+}
+
+// After a field: Moves past the delimiter, and returns false if that was the end of the row.
+ALWAYS_INLINE bool next_csv_field(const char** ptr, const char* last, char delimiter) {
+    if (*ptr == last)
+        return false;
+    const char ch = **ptr;
+    *ptr += 1;
+    return ch == delimiter;
+}
+
+// Just the row structure: Moves `*ptr` past the end of the current row.
+void skip_csv_row(const char** ptr, const char* last, char delimiter) {
+    CsvField ignored;
+    do {
+        read_csv_text(ptr, last, delimiter, &ignored);
+    } while (next_csv_field(ptr, last, delimiter));
+}
+
+CsvColumnType infer_csv_column_type(bool any_values, bool all_ints, bool all_doubles) {
+    // Nothing but empty fields: Double accepts the most numbers, so the
+    // later rows have the best chance.
+    if (!any_values)
+        return CsvColumnType::Double;
+    if (all_ints)
+        return CsvColumnType::Int64;
+    return all_doubles ? CsvColumnType::Double : CsvColumnType::Text;
+}
+
+// Loads the CSV in [first, last) into `table`, see `CSV_SAMPLE_ROWS`.
+void new_csv_load(const char* first, const char* last, char delimiter, bool has_header, CsvTable* table) {
+    assert(table);
+    table->columns.clear();
+    table->num_rows = 0;
+    const char* ptr = first;
+    if (!skip_blank_csv_lines(&ptr, last))
+        return;
+
+    // The first line decides how many columns there are.
+    do {
+        CsvColumn column {};
+        column.type = CsvColumnType::Double;
+        if (has_header) {
+            read_csv_text(&ptr, last, delimiter, &column.name);
+        } else {
+            column.name = CsvField { ptr, ptr };
+            CsvField ignored;
+            read_csv_text(&ptr, last, delimiter, &ignored);
+        }
+        table->columns.push_back(column);
+    } while (next_csv_field(&ptr, last, delimiter));
+    const size_t num_columns = table->columns.size();
+    const char* data = has_header ? ptr : first;
+
+    // Sample some rows to figure out the types.
+    std::vector<bool> any_values(num_columns, false);
+    std::vector<bool> all_ints(num_columns, true);
+    std::vector<bool> all_doubles(num_columns, true);
+    ptr = data;
+    for (size_t row = 0; row < CSV_SAMPLE_ROWS && skip_blank_csv_lines(&ptr, last); ++row) {
+        bool more_fields = true;
+        for (size_t i = 0; i < num_columns && more_fields; ++i) {
+            const char* field_first = ptr;
+            CsvField field;
+            read_csv_text(&ptr, last, delimiter, &field);
+            while (field.first != field.last && is_space(*field.first))
+                field.first += 1;
+            // Empty fields don't tell us anything.
+            if (field.first != field.last) {
+                any_values[i] = true;
+                long long int_value;
+                double double_value;
+                const char* field_ptr = field_first;
+                if (all_ints[i])
+                    all_ints[i] = read_csv_number(&field_ptr, last, delimiter, CsvColumnType::Int64, &int_value, &double_value);
+                field_ptr = field_first;
+                if (all_doubles[i])
+                    all_doubles[i] = read_csv_number(&field_ptr, last, delimiter, CsvColumnType::Double, &int_value, &double_value);
+            }
+            more_fields = next_csv_field(&ptr, last, delimiter);
+        }
+        if (more_fields)
+            skip_csv_row(&ptr, last, delimiter);
+    }
+    for (size_t i = 0; i < num_columns; ++i)
+        table->columns[i].type = infer_csv_column_type(any_values[i], all_ints[i], all_doubles[i]);
+
+    // And now for real, one row at a time, straight into the columns.
+    ptr = data;
+    size_t num_rows = 0;
+    while (skip_blank_csv_lines(&ptr, last)) {
+        bool more_fields = true;
+        for (CsvColumn& column : table->columns) {
+            if ((num_rows % 8) == 0)
+                column.invalid.push_back(0);
+            long long int_value = 0;
+            double double_value = 0.0;
+            CsvField text { ptr, ptr };
+            bool valid = false;
+            if (more_fields) {
+                if (column.type == CsvColumnType::Text) {
+                    read_csv_text(&ptr, last, delimiter, &text);
+                    valid = true;
+                } else {
+                    valid = read_csv_number(&ptr, last, delimiter, column.type, &int_value, &double_value);
+                }
+                more_fields = next_csv_field(&ptr, last, delimiter);
+            }
+
+            switch (column.type) {
+            case CsvColumnType::Int64:
+                column.ints.push_back(valid ? int_value : 0);
+                break;
+            case CsvColumnType::Double:
+                column.doubles.push_back(double_value);
+                break;
+            case CsvColumnType::Text:
+                column.texts.push_back(text);
+                break;
+            default:
+                assert(false); // ASSERT_NOT_REACHED();
+            }
+            if (!valid) {
+                column.invalid.back() |= 1 << (num_rows % 8);
+                column.num_invalid += 1;
+            }
+        }
+        if (more_fields)
+            skip_csv_row(&ptr, last, delimiter);
+        num_rows += 1;
+    }
+    table->num_rows = num_rows;
+}
+
+struct Testcase {
+    const char* test_name;
+    int should_consume;
+    const char* hex;
+    const char* test_string;
+    bool skip_old = false;
+};
+
+#define TEN_ZEROS "0000000000"
+#define HUNDRED_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS TEN_ZEROS
+
 static Testcase TESTCASES[] = {
     // What I came up with on my own:
     {"BW00", 0, "0000000000000000", ".."},
@@ -564,6 +3582,11 @@ static Testcase TESTCASES[] = {
     {"BWN17", -1, "c3389e56ee5e7a57", "-6929495644600919"},
     {"BWN18", -1, "630a2b939cbca17f", "12345678901234567890e150"},
     {"BWN19", -1, "24c186a8a3f159df", "12345678901234567890e-150"},
+    // Exponent overflow must look at the sign of the exponent, not of the number:
+    {"BWN20", -1, "7ff0000000000000", "1e99999999999", true},
+    // Non-ASCII bytes are neither whitespace nor digits, no matter the locale:
+    {"BWN21", 0, "0000000000000000", "\xa0" "1"},
+    {"BWN22", 1, "4014000000000000", "5\xb9"},
 
     // From the Serenity GitHub tracker:
     // https://github.com/SerenityOS/serenity/issues/1979
@@ -720,109 +3743,1840 @@ static Testcase TESTCASES[] = {
     {"C78", -1, "44b52d02c7e14af6", "10000000000000000000000000000000000000000e-17"},
     {"C79", -1, "0007802665fd9600", "104308485241983990666713401708072175773165034278685682646111762292409330928739751702404658197872319129036519947435319418387839758990478549477777586673075945844895981012024387992135617064532141489278815239849108105951619997829153633535314849999674266169258928940692239684771590065027025835804863585454872499320500023126142553932654370362024104462255244034053203998964360882487378334860197725139151265590832887433736189468858614521708567646743455601905935595381852723723645799866672558576993978025033590728687206296379801363024094048327273913079612469982585674824156000783167963081616214710691759864332339239688734656548790656486646106983450809073750535624894296242072010195710276073042036425579852459556183541199012652571123898996574563824424330960027873516082763671875e-1075"},
     {"C80", -1, "4025cccccccccccd", "10.900000000000000012345678912345678912345"},
+    // Exactly halfway between 1 and the next double, so only the very last digit decides:
+    {"C81", -1, "3ff0000000000000", "1.00000000000000011102230246251565404236316680908203125"},
+    {"C82", -1, "3ff0000000000000", "1.00000000000000011102230246251565404236316680908203124999"},
+    {"C83", -1, "3ff0000000000001", "1.00000000000000011102230246251565404236316680908203125" HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS "1"},
+    {"C84", -1, "3ff0000000000000", "1.00000000000000011102230246251565404236316680908203125" HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS HUNDRED_ZEROS "0"},
     // I'm impressed that my stdlib actually generates the right double values!
     // … although it has some funny ideas about which suffixes it accepts.
 
-    // For the future: hexadecimal floats.
-    // Note that "0x579a" is "0xabcd << 1" with the top bit cut off, just as expected.
-    {"Fp1", -1, "7c2579a000000000", "0xab.cdpef"},
-    // Sneaky floating point :P
-    {"Fp2", -1, "43e9400000000000", "0xCAPE"},
+    // Hexadecimal floats.
+    // Note that "0x579a" is "0xabcd << 1" with the top bit cut off, just as expected.
+    // The exponent is decimal though, so it can't start with 'e'.
+    {"Fp1", 7, "406579a000000000", "0xab.cdpef"},
+    // Sneaky floating point :P
+    {"Fp2", 4, "4069400000000000", "0xCAPE"},
+    {"Fp3", -1, "4030000000000000", "0X1P+4"},
+    {"Fp4", -1, "3ff0000000000000", "0x.8p1"},
+    {"Fp5", 3, "3ff0000000000000", "0x1p"},
+    {"Fp6", 1, "0000000000000000", "0x"},
+    {"Fp7", 2, "8000000000000000", "-0xg"},
+    {"Fp8", -1, "8000000000000000", "-0x0p+0"},
+    {"Fp9", -1, "43323456789abcdf", "0x123456789abcdef0123p-20"},
+    {"Fp10", -1, "40a0000000000000", "0x0.0000000000000000000001p99"},
+    // Rounding, including denormals:
+    {"Fp11", -1, "0000000000000001", "0x1p-1074"},
+    {"Fp12", -1, "0000000000000000", "0x1p-1075"},
+    {"Fp13", -1, "0000000000000001", "0x1.8p-1075"},
+    {"Fp14", -1, "0010000000000000", "0x1.ffffffffffffffffffp-1023"},
+    {"Fp15", -1, "7ff0000000000000", "0x1.fffffffffffff8p1023"},
+    {"Fp16", -1, "7fefffffffffffff", "0x1.fffffffffffff7ffp1023"},
+    {"Fp17", -1, "3ff0000000000000", "0x1.00000000000008p0"},
+    {"Fp18", -1, "3ff0000000000001", "0x1.000000000000080000000001p0"},
+    // Huge exponents are no slower than small ones:
+    {"Fp19", -1, "7ff0000000000000", "0x1p99999999999"},
+    {"Fp20", -1, "0000000000000000", "0x1p-99999999999"},
+};
+
+constexpr size_t NUM_TESTCASES = sizeof(TESTCASES) / sizeof(TESTCASES[0]);
+
+typedef double (*strtod_fn_t)(const char* str, char** endptr);
+
+bool evaluate_strtod(strtod_fn_t strtod_fn, const char* test_string, const char* expect_hex, int expect_consume, long long expect_ll) {
+    union readable_t {
+        double as_double;
+        unsigned char as_bytes[8];
+    };
+    typedef char assert_double_8bytes[sizeof(double) == 8 ? 1 : -1];
+    (void)sizeof(assert_double_8bytes);
+    typedef char assert_readable_8bytes[sizeof(readable_t) == 8 ? 1 : -1];
+    (void)sizeof(assert_readable_8bytes);
+    readable_t readable;
+    char* endptr = (char*)0x123;
+
+    readable.as_double = strtod_fn(test_string, &endptr);
+
+    char actual_hex[16 + 1] = {0};
+    for (size_t i = 0; i < 8; ++i) {
+        // Little endian, need to reverse order. Ugh.
+        snprintf(&actual_hex[2 * i], 3, "%02x", readable.as_bytes[8 - 1 - i]);
+    }
+
+    bool actual_consume_possible = false;
+    int actual_consume;
+
+    if (endptr < test_string) {
+        actual_consume = 999;
+    } else {
+        const char* max_endptr = test_string + serenity_strlen(test_string);
+        actual_consume_possible = endptr <= max_endptr;
+        actual_consume = endptr - test_string;
+    }
+
+    long long actual_ll;
+    memcpy(&actual_ll, &readable.as_double, sizeof(actual_ll));
+    long long off_by = expect_ll - actual_ll;
+
+    bool ofby1_hex = off_by != 0 && -8 <= off_by && off_by <= 8;
+    bool wrong_hex = !ofby1_hex && strcmp(expect_hex, actual_hex) != 0;
+    bool error_cns = !actual_consume_possible;
+    bool wrong_cns = !error_cns && (actual_consume != expect_consume);
+
+    printf(" %s%s%s(%s%2u%s)",
+           ofby1_hex ? TEXT_OFBY1 : wrong_hex ? TEXT_WRONG : "",
+           actual_hex,
+           (ofby1_hex || wrong_hex) ? TEXT_RESET : "",
+           error_cns ? TEXT_ERROR : wrong_cns ? TEXT_WRONG : "",
+           actual_consume,
+           (error_cns || wrong_cns) ? TEXT_RESET : "");
+
+    return wrong_hex || error_cns || wrong_cns;
+}
+
+long long hex_to_ll(const char* hex) {
+    long long result = 0;
+    for (int i = 0; i < 16; ++i) {
+        char ch = *(hex + i);
+        int digit;
+        if ('0' <= ch && ch <= '9') {
+            digit = ch - '0';
+        } else if ('a' <= ch && ch <= 'f') {
+            digit = ch - 'a' + 10;
+        } else {
+            printf("\n!!! Encountered char %02x at %d.\n", ch, i);
+            assert(false);
+            // Only reachable with -DNDEBUG, e.g. in the bench build.
+            digit = 0;
+        }
+        result <<= 4;
+        result += digit;
+    }
+    return result;
+}
+
+struct BatchTestcase {
+    const char* test_name;
+    const char* test_string;
+    const char* delimiters;
+    size_t max_values;
+    size_t expect_count;
+    unsigned char expect_failures;
+    const char* hex[8];
+};
+
+static BatchTestcase BATCH_TESTCASES[] = {
+    {"B01", "1,2.5,-3e2", ",", 8, 3, 0x00, {"3ff0000000000000", "4004000000000000", "c072c00000000000"}},
+    {"B02", "  1 \t 2\n", " \t\n", 8, 2, 0x00, {"3ff0000000000000", "4000000000000000"}},
+    // Empty fields are skipped, partial fields are failures:
+    {"B03", ",,1,,,abc,2x,", ",", 8, 3, 0x06, {"3ff0000000000000", "0000000000000000", "4000000000000000"}},
+    {"B04", "", ",", 8, 0, 0x00, {}},
+    {"B05", "inf;-nan;0x10", ";", 8, 3, 0x00, {"7ff0000000000000", "fff8000000000000", "4030000000000000"}},
+    // Stops early, and can be resumed:
+    {"B06", "1 2 3", " ", 2, 2, 0x00, {"3ff0000000000000", "4000000000000000"}},
+    // Delimiters that are also number syntax split the number, just like strtok would:
+    {"B07", "1.5", ".", 8, 2, 0x00, {"3ff0000000000000", "4014000000000000"}},
+    {"B08", "1e5 2", "e ", 8, 3, 0x00, {"3ff0000000000000", "4014000000000000", "4000000000000000"}},
+    {"B09", "0x10", "x", 8, 2, 0x00, {"0000000000000000", "4024000000000000"}},
+    {"B10", "2.5e-3", "-", 8, 2, 0x01, {"4004000000000000", "4008000000000000"}},
+    // Trailing whitespace that isn't a delimiter is still garbage:
+    {"B11", "1 e5", "e", 8, 2, 0x01, {"3ff0000000000000", "4014000000000000"}},
+};
+
+constexpr size_t NUM_BATCH_TESTCASES = sizeof(BATCH_TESTCASES) / sizeof(BATCH_TESTCASES[0]);
+
+int run_batch_testcases() {
+    printf("Running %zu batch testcases...\n", NUM_BATCH_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_BATCH_TESTCASES; i++) {
+        const BatchTestcase& tc = BATCH_TESTCASES[i];
+        double values[8];
+        unsigned char failures[1] = { 0xff };
+        size_t count = new_strtod_batch(tc.test_string, tc.delimiters, values, tc.max_values, failures, nullptr);
+
+        bool bad = count != tc.expect_count;
+        // Only the bits for the numbers we actually parsed are defined.
+        const unsigned char mask = (1 << count) - 1;
+        bad |= (failures[0] & mask) != tc.expect_failures;
+        for (size_t j = 0; !bad && j < count; ++j) {
+            long long actual_ll;
+            memcpy(&actual_ll, &values[j], sizeof(actual_ll));
+            bad |= actual_ll != hex_to_ll(tc.hex[j]);
+        }
+
+        printf("%3zu(%-5s): %s%s%s – count %zu, failures %02x\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "",
+               count, failures[0] & mask);
+        failed_tests += bad;
+    }
+    printf("Out of %zu batch tests, %d failed.\n", NUM_BATCH_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+// Writes `contents` to a fresh temporary file, parses it with `new_strtod_file`,
+// and checks that this agrees with `new_strtod_batch` on the same input.
+bool check_file_parse(const char* contents, size_t length, const char* delimiters, unsigned num_threads) {
+    char path[] = "/tmp/mystrtod-test-XXXXXX";
+    const int fd = mkstemp(path);
+    assert(fd >= 0);
+    const bool written = write(fd, contents, length) == static_cast<ssize_t>(length);
+    assert(written);
+    (void)written;
+    close(fd);
+
+    double* actual_values = nullptr;
+    size_t actual_count = 0;
+    size_t actual_failed = 0;
+    const bool ok = new_strtod_file(path, delimiters, num_threads, &actual_values, &actual_count, &actual_failed);
+    unlink(path);
+    if (!ok)
+        return false;
+
+    // `contents` is NUL-terminated, so the batch parser can go first.
+    const size_t max_values = length / 2 + 1;
+    double* expect_values = static_cast<double*>(malloc(max_values * sizeof(double)));
+    unsigned char* failures = static_cast<unsigned char*>(malloc(max_values / 8 + 1));
+    const size_t expect_count = new_strtod_batch(contents, delimiters, expect_values, max_values, failures, nullptr);
+    size_t expect_failed = 0;
+    for (size_t i = 0; i < expect_count; ++i)
+        expect_failed += (failures[i / 8] >> (i % 8)) & 1;
+
+    bool good = actual_count == expect_count && actual_failed == expect_failed;
+    for (size_t i = 0; good && i < expect_count; ++i)
+        good = memcmp(&actual_values[i], &expect_values[i], sizeof(double)) == 0;
+
+    free(failures);
+    free(expect_values);
+    free(actual_values);
+    return good;
+}
+
+int run_file_testcases() {
+    // Big enough that every thread gets a share, with some garbage thrown in.
+    const size_t num_numbers = 100000;
+    char* contents = static_cast<char*>(malloc(num_numbers * 32 + 1));
+    size_t length = 0;
+    uint32_t state = 12345;
+    for (size_t i = 0; i < num_numbers; ++i) {
+        state = state * 1103515245 + 12345;
+        const char* separator = (state & 0x100) ? "\n" : "  ";
+        if ((state & 0xFF) == 0) {
+            length += sprintf(contents + length, "x%zu%s", i, separator);
+        } else {
+            length += sprintf(contents + length, "%.17g%s", (state >> 8) * 1.0e-3 - 5000.0, separator);
+        }
+    }
+
+    struct {
+        const char* name;
+        const char* contents;
+        size_t length;
+        const char* delimiters;
+        unsigned num_threads;
+    } file_testcases[] = {
+        {"FL01", contents, length, " \n", 1},
+        {"FL02", contents, length, " \n", 2},
+        {"FL03", contents, length, " \n", 3},
+        {"FL04", contents, length, " \n", 16},
+        {"FL05", contents, length, " \n", 0},
+        {"FL06", "", 0, " \n", 4},
+        {"FL07", "\n\n\n", 3, " \n", 4},
+        {"FL08", "1,2,,3.5e1", 10, ",", 4},
+        // Delimiters that are also number syntax:
+        {"FL09", "1e5 2", 5, "e ", 2},
+        {"FL10", "1.5.25\n0x1p3", 13, ".\nx", 3},
+        {"FL11", contents, length, " \n.e", 4},
+    };
+    const size_t num_file_testcases = sizeof(file_testcases) / sizeof(file_testcases[0]);
+
+    printf("Running %zu file testcases...\n", num_file_testcases);
+    int failed_tests = 0;
+    for (size_t i = 0; i < num_file_testcases; i++) {
+        const bool good = check_file_parse(file_testcases[i].contents, file_testcases[i].length,
+                                           file_testcases[i].delimiters, file_testcases[i].num_threads);
+        printf("%3zu(%-5s): %s%s%s – %zu bytes, %u threads\n", i, file_testcases[i].name,
+               good ? "" : TEXT_WRONG, good ? "good" : "FAIL", good ? "" : TEXT_RESET,
+               file_testcases[i].length, file_testcases[i].num_threads);
+        failed_tests += good ? 0 : 1;
+    }
+    printf("Out of %zu file tests, %d failed.\n", num_file_testcases, failed_tests);
+    free(contents);
+    return failed_tests;
+}
+
+// Every kernel must count exactly the fields the scalar code counts. Random bytes
+// (including ones with the top bit set), random delimiters, and every length up
+// to a few blocks, so that the tail and the block boundaries both get exercised.
+int run_kernel_testcases() {
+    static const int KERNEL_ROUNDS = 2000;
+    printf("Running %d kernel testcases per kernel...\n", KERNEL_ROUNDS);
+    int failed_tests = 0;
+    unsigned char buffer[3 * 64 + 7];
+    uint32_t state = 54321;
+    for (int k = 1; k < NUM_STRTOD_KERNELS; ++k) {
+        const StrtodKernel kernel = static_cast<StrtodKernel>(k);
+        if (!strtod_kernel_supported(kernel)) {
+            printf("(%s: not supported by this CPU, skipped.)\n", STRTOD_KERNEL_NAMES[k]);
+            continue;
+        }
+        int failed_rounds = 0;
+        for (int round = 0; round < KERNEL_ROUNDS; ++round) {
+            bool is_delimiter[256] = {};
+            unsigned char delimiter_chars[4];
+            for (unsigned char& ch : delimiter_chars) {
+                state = state * 1103515245 + 12345;
+                ch = state >> 16;
+                is_delimiter[ch] = true;
+            }
+            for (unsigned char& ch : buffer) {
+                state = state * 1103515245 + 12345;
+                // Mostly delimiters and digits, like real input.
+                ch = (state & 0x300) ? delimiter_chars[(state >> 12) & 3] : (state >> 16);
+                if ((state & 0x300) == 0x300)
+                    ch = '0' + (state >> 20) % 10;
+            }
+            const size_t offset = round % 7;
+            const size_t length = round % (sizeof(buffer) - offset);
+            const char* first = reinterpret_cast<const char*>(buffer) + offset;
+            const size_t expect = STRTOD_KERNEL_TABLES[StrtodKernel::Scalar].count_fields(first, first + length, is_delimiter);
+            const size_t actual = STRTOD_KERNEL_TABLES[kernel].count_fields(first, first + length, is_delimiter);
+            if (expect != actual) {
+                if (failed_rounds == 0)
+                    printf("%3d(%-5s): %sFAIL%s – expected %zu fields, got %zu, %zu bytes\n", round, STRTOD_KERNEL_NAMES[k],
+                           TEXT_WRONG, TEXT_RESET, expect, actual, length);
+                failed_rounds += 1;
+            }
+        }
+        failed_tests += failed_rounds;
+    }
+    printf("Out of %d kernel tests, %d failed.\n", (NUM_STRTOD_KERNELS - 1) * KERNEL_ROUNDS, failed_tests);
+    return failed_tests;
+}
+
+int run_range_testcases() {
+    // Feed each testcase to the range overload, from a buffer that has
+    // no NUL byte at all. It must behave exactly like the original.
+    printf("Running %zu range testcases...\n", NUM_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_TESTCASES; i++) {
+        const Testcase& tc = TESTCASES[i];
+        const size_t len = strlen(tc.test_string);
+        char* buffer = static_cast<char*>(malloc(len > 0 ? len : 1));
+        memcpy(buffer, tc.test_string, len);
+
+        char* expect_endptr;
+        const double expect_value = new_strtod(tc.test_string, &expect_endptr);
+        char* actual_endptr;
+        const double actual_value = new_strtod(buffer, buffer + len, &actual_endptr);
+
+        bool bad = memcmp(&expect_value, &actual_value, sizeof(double)) != 0;
+        bad |= (expect_endptr - tc.test_string) != (actual_endptr - buffer);
+        if (bad) {
+            printf("%3zu(%-5s): %sFAIL%s – %s\n", i, tc.test_name, TEXT_WRONG, TEXT_RESET, tc.test_string);
+        }
+        failed_tests += bad;
+        free(buffer);
+    }
+    printf("Out of %zu range tests, %d failed.\n", NUM_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+// The compact table must not change a single bit, see `CompactPowersOfFive`.
+int run_compact_testcases() {
+    printf("Running %zu compact table testcases...\n", NUM_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_TESTCASES; i++) {
+        const Testcase& tc = TESTCASES[i];
+        char* expect_endptr;
+        const double expect_value = new_strtod(tc.test_string, &expect_endptr);
+        char* actual_endptr;
+        const double actual_value = policy_strtod<CompactStrtodPolicy>(tc.test_string, &actual_endptr);
+
+        const bool bad = memcmp(&expect_value, &actual_value, sizeof(double)) != 0 || expect_endptr != actual_endptr;
+        if (bad) {
+            printf("%3zu(%-5s): %sFAIL%s – %s\n", i, tc.test_name, TEXT_WRONG, TEXT_RESET, tc.test_string);
+        }
+        failed_tests += bad;
+    }
+    printf("Out of %zu compact table tests, %d failed.\n", NUM_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+struct PolicyTestcase {
+    const char* test_name;
+    int should_consume;
+    const char* hex;
+    const char* test_string;
+};
+
+// Everything PlainDecimalPolicy turns off must stop the parse right there.
+static PolicyTestcase PLAIN_DECIMAL_TESTCASES[] = {
+    {"P01", 9, "40934a456d5cfaad", "1234.5678"},
+    {"P02", 5, "3f50624dd2f1a9fc", "0.001"},
+    {"P03", 0, "0000000000000000", "-1"},
+    {"P04", 0, "0000000000000000", " 1"},
+    {"P05", 1, "3ff0000000000000", "1e5"},
+    {"P06", 0, "0000000000000000", "inf"},
+    {"P07", 1, "0000000000000000", "0x10"},
+    // Digits beyond max_digits are not consumed:
+    {"P08", 18, "437b69b4ba630f35", "1234567890123456789"},
+    // Leading zeros don't count towards max_digits:
+    {"P09", 24, "3bcd0ae4cf767531", "0.0000000000000000000123"},
+    {"P10", 27, "3ff0000000000000", "000000000000000000000000001"},
+    {"P11", 28, "3ff3c0ca428c59fb", "0000000001.23456789012345678"},
+};
+
+constexpr size_t NUM_PLAIN_DECIMAL_TESTCASES = sizeof(PLAIN_DECIMAL_TESTCASES) / sizeof(PLAIN_DECIMAL_TESTCASES[0]);
+
+int run_policy_testcases() {
+    printf("Running %zu policy testcases...\n", NUM_PLAIN_DECIMAL_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_PLAIN_DECIMAL_TESTCASES; i++) {
+        const PolicyTestcase& tc = PLAIN_DECIMAL_TESTCASES[i];
+        printf("%3zu(%-5s):", i, tc.test_name);
+        bool bad = evaluate_strtod(policy_strtod<PlainDecimalPolicy>, tc.test_string, tc.hex, tc.should_consume, hex_to_ll(tc.hex));
+        printf(" – %s\n", tc.test_string);
+        failed_tests += bad;
+    }
+    printf("Out of %zu policy tests, %d failed.\n", NUM_PLAIN_DECIMAL_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+// Everything outside of RFC 8259 must stop the parse right there.
+static PolicyTestcase JSON_TESTCASES[] = {
+    {"J01", 1, "0000000000000000", "0"},
+    {"J02", 2, "8000000000000000", "-0"},
+    {"J03", 10, "3ff3c0c1fc8f3238", "123.456e-2"},
+    {"J04", 4, "40f86a0000000000", "1e+5"},
+    {"J05", 4, "3f847ae147ae147b", "1E-2"},
+    {"J06", 8, "bff4000000000000", "-12.5e-1"},
+    {"J07", 8, "3eb0c6f7a0b5ed8d", "0.000001"},
+    {"J08", 23, "4484ea15b273b38a", "12345678901234567890123"},
+    // Leading zeros, dangling points and exponents end the number early:
+    {"J09", 1, "0000000000000000", "01"},
+    {"J10", 2, "8000000000000000", "-01.5"},
+    {"J11", 1, "3ff0000000000000", "1."},
+    {"J12", 1, "3ff0000000000000", "1e"},
+    {"J13", 1, "3ff0000000000000", "1e+"},
+    {"J14", 5, "4097700000000000", "1.5e3x"},
+    {"J15", 1, "0000000000000000", "0x10"},
+    // No number at all:
+    {"J16", 0, "0000000000000000", ".5"},
+    {"J17", 0, "0000000000000000", "-.5"},
+    {"J18", 0, "0000000000000000", "-"},
+    {"J19", 0, "0000000000000000", "+1"},
+    {"J20", 0, "0000000000000000", " 1"},
+    {"J21", 0, "0000000000000000", "inf"},
+    {"J22", 0, "0000000000000000", "-nan"},
+    {"J23", 0, "0000000000000000", ""},
+};
+
+constexpr size_t NUM_JSON_TESTCASES = sizeof(JSON_TESTCASES) / sizeof(JSON_TESTCASES[0]);
+
+int run_json_testcases() {
+    printf("Running %zu JSON testcases...\n", NUM_JSON_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_JSON_TESTCASES; i++) {
+        const PolicyTestcase& tc = JSON_TESTCASES[i];
+        printf("%3zu(%-5s):", i, tc.test_name);
+        bool bad = evaluate_strtod(new_strtod_json, tc.test_string, tc.hex, tc.should_consume, hex_to_ll(tc.hex));
+        // The range overload must stop at the same place, without the NUL byte.
+        const size_t len = strlen(tc.test_string);
+        char* range_endptr;
+        const double range_value = new_strtod_json(tc.test_string, tc.test_string + len, &range_endptr);
+        long long range_ll;
+        memcpy(&range_ll, &range_value, sizeof(range_ll));
+        if (range_endptr - tc.test_string != tc.should_consume || range_ll != hex_to_ll(tc.hex)) {
+            printf(" %sRANGE%s", TEXT_WRONG, TEXT_RESET);
+            bad = true;
+        }
+        printf(" – %s\n", tc.test_string);
+        failed_tests += bad;
+    }
+    printf("Out of %zu JSON tests, %d failed.\n", NUM_JSON_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+struct CounterTestcase {
+    const char* test_name;
+    StrtodPath path;
+    // -1 if this doesn't count as a nonzero decimal number.
+    int num_digits;
+    int exponent;
+    const char* test_string;
+};
+
+static CounterTestcase COUNTER_TESTCASES[] = {
+    {"C01", PathNoNumber, -1, 0, "abc"},
+    {"C02", PathNoNumber, -1, 0, ""},
+    {"C03", PathInfinity, -1, 0, "-Infinity"},
+    {"C04", PathNaN, -1, 0, "nan"},
+    {"C05", PathHex, -1, 0, "0x1.8p3"},
+    {"C06", PathZero, -1, 0, "0x"},
+    {"C07", PathZero, -1, 0, "-0.000e999"},
+    {"C08", PathTooSmall, 1, -400, "1e-400"},
+    {"C09", PathTooLarge, 2, 398, "12e398"},
+    {"C10", PathClinger, 2, -1, "1.5"},
+    {"C11", PathClinger, 1, 22, "1e22"},
+    {"C12", PathEiselLemire, 1, 23, "1e23"},
+    {"C13", PathEiselLemire, 17, -33, "1.2345678901234567e-17"},
+    {"C14", PathManyDigits, 24, 5, "123456789012345678901234"},
+    // 1 + 2^-53, exactly halfway between two doubles:
+    {"C15", PathSlow, 55, -18, "1.00000000000000011102230246251565404236316680908203125"},
+};
+
+constexpr size_t NUM_COUNTER_TESTCASES = sizeof(COUNTER_TESTCASES) / sizeof(COUNTER_TESTCASES[0]);
+
+int run_counter_testcases() {
+    if (!MYSTRTOD_COUNTERS) {
+        // Then they must stay empty, no matter what we parse.
+        printf("Running %zu counter testcases (compiled out)...\n", NUM_COUNTER_TESTCASES);
+    } else {
+        printf("Running %zu counter testcases...\n", NUM_COUNTER_TESTCASES);
+    }
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_COUNTER_TESTCASES; i++) {
+        const CounterTestcase& tc = COUNTER_TESTCASES[i];
+        new_strtod_reset_counters();
+        char* endptr;
+        new_strtod(tc.test_string, &endptr);
+        const StrtodCounters counters = new_strtod_counters();
+
+        StrtodCounters expected = EMPTY_STRTOD_COUNTERS;
+        if (MYSTRTOD_COUNTERS) {
+            expected.paths[tc.path] = 1;
+            if (tc.num_digits != -1) {
+                expected.digits[tc.num_digits < STRTOD_DIGIT_BUCKETS - 1 ? tc.num_digits : STRTOD_DIGIT_BUCKETS - 1] = 1;
+                expected.exponents[strtod_exponent_bucket(tc.exponent)] = 1;
+                expected.min_exponent = tc.exponent;
+                expected.max_exponent = tc.exponent;
+            }
+        }
+        const bool bad = memcmp(&counters, &expected, sizeof(StrtodCounters)) != 0;
+        printf("%3zu(%-5s): %s%s%s – %s (%s)\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "",
+               tc.test_string, STRTOD_PATH_NAMES[tc.path]);
+        failed_tests += bad;
+    }
+    new_strtod_reset_counters();
+    printf("Out of %zu counter tests, %d failed.\n", NUM_COUNTER_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+// Hits must return exactly what `new_strtod` returns, including `endptr`.
+bool check_cached_parse(const char* str, const char* last) {
+    char* expect_endptr;
+    const double expect_value = last ? new_strtod(str, last, &expect_endptr) : new_strtod(str, &expect_endptr);
+    char* actual_endptr;
+    const double actual_value = last ? new_strtod_cached(str, last, &actual_endptr) : new_strtod_cached(str, &actual_endptr);
+    return memcmp(&expect_value, &actual_value, sizeof(double)) != 0 || expect_endptr != actual_endptr;
+}
+
+// Tokens that share a cache entry (or nearly do), but differ in what follows them.
+static const char* CACHE_TESTCASES[] = {
+    "0", "0 ", "0,1", " 0", "\t0;", "-0", "1.0", "1.0e", "1.0e+", "1.0e+1", "1.0e+1x",
+    "abc", " abc", "-", "-.", "0x", "0x1p", "0x1p3", "inf", "infinity", "nan",
+    "123456789012345", "1234567890123456", "1.5;2.5", "   ",
+};
+
+constexpr size_t NUM_CACHE_TESTCASES = sizeof(CACHE_TESTCASES) / sizeof(CACHE_TESTCASES[0]);
+
+int run_cache_testcases() {
+    printf("Running %zu cache testcases...\n", NUM_TESTCASES + NUM_CACHE_TESTCASES + 1);
+    int failed_tests = 0;
+    new_strtod_reset_cache();
+    // Twice, so that everything that fits is a hit the second time.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < NUM_TESTCASES; i++) {
+            const Testcase& tc = TESTCASES[i];
+            const bool bad = check_cached_parse(tc.test_string, nullptr);
+            if (bad)
+                printf("%3zu(%-5s): %sFAIL%s – %s\n", i, tc.test_name, TEXT_WRONG, TEXT_RESET, tc.test_string);
+            failed_tests += bad;
+        }
+    }
+    for (size_t i = 0; i < NUM_CACHE_TESTCASES; i++) {
+        const char* str = CACHE_TESTCASES[i];
+        bool bad = check_cached_parse(str, nullptr);
+        bad |= check_cached_parse(str, nullptr);
+        // Every prefix as a range, too: The end of the range ends the token.
+        for (size_t len = 0; len <= strlen(str); ++len)
+            bad |= check_cached_parse(str, str + len);
+        printf("%3zu(%-5s): %s%s%s – \"%s\"\n", i, "cache",
+               bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "", str);
+        failed_tests += bad;
+    }
+
+    // "0" and "1.0" are misses, then hits no matter what follows them.
+    new_strtod_reset_cache();
+    const char* repeated[] = { "0", "1.0", "0", "1.0 ", "1.0,2", "-1", "12345678901234567890", " 0" };
+    for (const char* str : repeated) {
+        char* endptr;
+        new_strtod_cached(str, &endptr);
+    }
+    const StrtodCacheStats stats = new_strtod_cache_stats();
+    const bool bad = stats.hits != 4 || stats.misses != 3 || stats.bypassed != 1;
+    printf("%3s(%-5s): %s%s%s – %zu hits, %zu misses, %zu bypassed\n", "", "stats",
+           bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "",
+           static_cast<size_t>(stats.hits), static_cast<size_t>(stats.misses), static_cast<size_t>(stats.bypassed));
+    failed_tests += bad;
+    new_strtod_reset_cache();
+
+    printf("Out of %zu cache tests, %d failed.\n", NUM_TESTCASES + NUM_CACHE_TESTCASES + 1, failed_tests);
+    return failed_tests;
+}
+
+struct IntegerTestcase {
+    const char* test_name;
+    int base;
+    const char* test_string;
+};
+
+// Compared against the libc functions, including endptr and errno.
+static IntegerTestcase INTEGER_TESTCASES[] = {
+    {"I01", 10, "0"},
+    {"I02", 10, "123"},
+    {"I03", 10, "  -123"},
+    {"I04", 10, "\t+42abc"},
+    {"I05", 10, "2147483647"},
+    {"I06", 10, "2147483648"},
+    {"I07", 10, "-2147483648"},
+    {"I08", 10, "-2147483649"},
+    {"I09", 10, "4294967295"},
+    {"I10", 10, "4294967296"},
+    {"I11", 10, "-1"},
+    {"I12", 10, "9223372036854775807"},
+    {"I13", 10, "9223372036854775808"},
+    {"I14", 10, "-9223372036854775808"},
+    {"I15", 10, "-9223372036854775809"},
+    {"I16", 10, "18446744073709551615"},
+    {"I17", 10, "18446744073709551616"},
+    {"I18", 10, "-18446744073709551616"},
+    {"I19", 10, "123456789012345678901234567890 "},
+    {"I20", 10, "000000000000000000000000000001"},
+    {"I21", 0, "0x1F"},
+    {"I22", 16, "0x1F"},
+    {"I23", 16, "1f"},
+    {"I24", 0, "0X"},
+    {"I25", 16, "0xg"},
+    {"I26", 0, "017"},
+    {"I27", 0, "08"},
+    {"I28", 10, "0x1F"},
+    {"I29", 36, "Zz"},
+    {"I30", 2, "-1011"},
+    {"I31", 16, "-0x8000000000000000"},
+    {"I32", 16, "ffffffffffffffff"},
+    {"I33", 10, ""},
+    {"I34", 10, "   "},
+    {"I35", 10, "-"},
+    {"I36", 10, "+-1"},
+    {"I37", 1, "1"},
+    {"I38", 37, "1"},
+    {"I39", 8, "9"},
+    {"I40", 10, "12345678.9"},
+};
+
+constexpr size_t NUM_INTEGER_TESTCASES = sizeof(INTEGER_TESTCASES) / sizeof(INTEGER_TESTCASES[0]);
+
+// Runs both functions, and compares everything they report.
+template<typename T>
+bool compare_strtoi(T (*expect_fn)(const char*, char**, int), T (*actual_fn)(const char*, char**, int),
+                    const IntegerTestcase& tc) {
+    char* expect_endptr = (char*)0x123;
+    errno = 0;
+    const T expect_value = expect_fn(tc.test_string, &expect_endptr, tc.base);
+    const int expect_errno = errno;
+
+    char* actual_endptr = (char*)0x123;
+    errno = 0;
+    const T actual_value = actual_fn(tc.test_string, &actual_endptr, tc.base);
+    const int actual_errno = errno;
+
+    return expect_value == actual_value && expect_endptr == actual_endptr && expect_errno == actual_errno;
+}
+
+int run_integer_testcases() {
+    printf("Running %zu integer testcases...\n", NUM_INTEGER_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_INTEGER_TESTCASES; i++) {
+        const IntegerTestcase& tc = INTEGER_TESTCASES[i];
+        const bool good_l = compare_strtoi<long>(strtol, new_strtol, tc);
+        const bool good_ll = compare_strtoi<long long>(strtoll, new_strtoll, tc);
+        const bool good_ul = compare_strtoi<unsigned long>(strtoul, new_strtoul, tc);
+        const bool good_ull = compare_strtoi<unsigned long long>(strtoull, new_strtoull, tc);
+        const bool bad = !(good_l && good_ll && good_ul && good_ull);
+
+        printf("%3zu(%-5s): %s%s%s – l %s, ll %s, ul %s, ull %s – base %d: %s\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "",
+               good_l ? "ok" : "BAD", good_ll ? "ok" : "BAD", good_ul ? "ok" : "BAD", good_ull ? "ok" : "BAD",
+               tc.base, tc.test_string);
+        failed_tests += bad;
+    }
+    printf("Out of %zu integer tests, %d failed.\n", NUM_INTEGER_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+struct FixedTestcase {
+    const char* test_name;
+    int scale;
+    long long expect;
+    unsigned expect_flags;
+    int should_consume;
+    const char* test_string;
+};
+
+static FixedTestcase FIXED_TESTCASES[] = {
+    {"X01", 4, 123456, 0, 7, "12.3456"},
+    {"X02", 4, 123450, 0, 6, "12.345"},
+    {"X03", 8, 10000000, 0, 3, "0.1"},
+    {"X04", 2, -1999, FixedTruncated, 9, " -19.9999"},
+    {"X05", 4, 15, 0, 6, "1.5e-3"},
+    {"X06", 0, 1500, 0, 5, "1.5e3"},
+    {"X07", 2, 0, FixedTruncated, 5, "0.001"},
+    {"X08", 0, LLONG_MAX, 0, 19, "9223372036854775807"},
+    {"X09", 0, LLONG_MIN, 0, 20, "-9223372036854775808"},
+    {"X10", 0, LLONG_MAX, FixedOverflow, 19, "9223372036854775808"},
+    {"X11", 2, LLONG_MIN, FixedOverflow, 20, "-92233720368547758.5"},
+    {"X12", 18, LLONG_MAX, FixedOverflow, 2, "10"},
+    {"X13", 18, 9223372036854775807, 0, 20, "9.223372036854775807"},
+    // More digits than fit into a long long, but they're all after the point:
+    {"X14", 2, 123, FixedTruncated, 32, "1.234567890123456789012345678901"},
+    {"X15", 2, 123, 0, 32, "1.230000000000000000000000000000"},
+    {"X16", 0, 12345678901234567, FixedTruncated, 41, "1234567890123456789012345678901234567e-20"},
+    {"X17", 4, 0, 0, 0, "abc"},
+    {"X18", 4, 0, 0, 1, "0x10"},
+    {"X19", 4, 0, 0, 0, "inf"},
+    {"X20", 4, 10000, 0, 1, "1e"},
+    {"X21", 3, LLONG_MAX, FixedOverflow, 6, "1e9999"},
+    {"X22", 3, 0, FixedTruncated, 7, "1e-9999"},
+};
+
+constexpr size_t NUM_FIXED_TESTCASES = sizeof(FIXED_TESTCASES) / sizeof(FIXED_TESTCASES[0]);
+
+int run_fixed_testcases() {
+    printf("Running %zu fixed point testcases...\n", NUM_FIXED_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_FIXED_TESTCASES; i++) {
+        const FixedTestcase& tc = FIXED_TESTCASES[i];
+        char* endptr;
+        unsigned flags;
+        const long long actual = new_strtofixed(tc.test_string, &endptr, tc.scale, &flags);
+        // The range overload must agree, without ever seeing a NUL byte.
+        char* range_endptr;
+        unsigned range_flags;
+        const long long range_actual = new_strtofixed(tc.test_string, tc.test_string + strlen(tc.test_string), &range_endptr, tc.scale, &range_flags);
+        const bool bad = actual != tc.expect || flags != tc.expect_flags || endptr - tc.test_string != tc.should_consume
+            || range_actual != actual || range_flags != flags || range_endptr != endptr;
+        printf("%3zu(%-5s): %s%20lld%s %u(%2d) – %s, scale %d\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", actual, bad ? TEXT_RESET : "", flags,
+               static_cast<int>(endptr - tc.test_string), tc.test_string, tc.scale);
+        failed_tests += bad;
+    }
+    printf("Out of %zu fixed point tests, %d failed.\n", NUM_FIXED_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+struct NarrowTestcase {
+    const char* test_name;
+    const char* float_hex;
+    const char* half_hex;
+    const char* bfloat16_hex;
+    const char* test_string;
+};
+
+// The whole string is always consumed here. Many of these are exactly halfway.
+static NarrowTestcase NARROW_TESTCASES[] = {
+    {"N01", "3f800000", "3c00", "3f80", "1"},
+    {"N02", "3dcccccd", "2e66", "3dcd", "0.1"},
+    {"N03", "80000000", "8000", "8000", "-0"},
+    {"N04", "7f800000", "7c00", "7f80", "inf"},
+    {"N05", "ffc00000", "fe00", "ffc0", "-nan"},
+    {"N06", "477fe000", "7bff", "4780", "65504"},
+    {"N07", "477feffd", "7bff", "4780", "65519.99"},
+    {"N08", "477ff000", "7c00", "4780", "65520"},
+    {"N09", "33800000", "0001", "3380", "5.960464477539063e-8"},
+    {"N10", "33000000", "0000", "3300", "2.98023223876953125e-8"},
+    {"N11", "33c00000", "0002", "33c0", "8.94069671630859375e-8"},
+    {"N12", "3f808000", "3c04", "3f80", "1.00390625"},
+    {"N13", "3f818000", "3c0c", "3f82", "1.01171875"},
+    {"N14", "7f7fffff", "7c00", "7f80", "3.4028235e38"},
+    {"N15", "7f800000", "7c00", "7f80", "3.4028236e38"},
+    {"N16", "00000001", "0000", "0000", "1e-45"},
+    {"N17", "00000000", "0000", "0000", "7e-46"},
+    {"N18", "7f7f0000", "7c00", "7f7f", "3.3895313892515355e38"},
+    {"N19", "33000000", "0000", "3300", "0x1p-25"},
+    {"N20", "33c00000", "0002", "33c0", "0x3p-25"},
+    {"N21", "477ff000", "7c00", "4780", "0x1.ffep15"},
+};
+
+constexpr size_t NUM_NARROW_TESTCASES = sizeof(NARROW_TESTCASES) / sizeof(NARROW_TESTCASES[0]);
+
+int run_narrow_testcases() {
+    printf("Running %zu narrow testcases...\n", NUM_NARROW_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_NARROW_TESTCASES; i++) {
+        const NarrowTestcase& tc = NARROW_TESTCASES[i];
+        const size_t len = strlen(tc.test_string);
+
+        char* float_endptr;
+        const float float_value = new_strtof(tc.test_string, &float_endptr);
+        uint32_t float_bits;
+        memcpy(&float_bits, &float_value, sizeof(float_bits));
+        char* half_endptr;
+        const uint16_t half_bits = new_strtof16(tc.test_string, &half_endptr);
+        char* bfloat16_endptr;
+        const uint16_t bfloat16_bits = new_strtobf16(tc.test_string, &bfloat16_endptr);
+
+        char actual_float_hex[8 + 1];
+        snprintf(actual_float_hex, sizeof(actual_float_hex), "%08x", float_bits);
+        char actual_half_hex[4 + 1];
+        snprintf(actual_half_hex, sizeof(actual_half_hex), "%04x", half_bits);
+        char actual_bfloat16_hex[4 + 1];
+        snprintf(actual_bfloat16_hex, sizeof(actual_bfloat16_hex), "%04x", bfloat16_bits);
+
+        bool bad = strcmp(actual_float_hex, tc.float_hex) != 0;
+        bad |= strcmp(actual_half_hex, tc.half_hex) != 0;
+        bad |= strcmp(actual_bfloat16_hex, tc.bfloat16_hex) != 0;
+        bad |= float_endptr != tc.test_string + len;
+        bad |= half_endptr != tc.test_string + len;
+        bad |= bfloat16_endptr != tc.test_string + len;
+
+        printf("%3zu(%-5s): %s%s%s – %s %s %s – %s\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "",
+               actual_float_hex, actual_half_hex, actual_bfloat16_hex, tc.test_string);
+        failed_tests += bad;
+    }
+    printf("Out of %zu narrow tests, %d failed.\n", NUM_NARROW_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+struct StreamingResult {
+    int count;
+    double value;
+    bool failed;
+};
+
+void collect_streaming_result(void* context, double value, bool failed) {
+    StreamingResult* result = static_cast<StreamingResult*>(context);
+    result->count += 1;
+    result->value = value;
+    result->failed = failed;
+}
+
+int run_streaming_testcases() {
+    // Split each testcase at every possible position, and feed the two halves
+    // separately. It must behave exactly like `new_strtod` on the whole thing.
+    printf("Running %zu streaming testcases...\n", NUM_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_TESTCASES; i++) {
+        const Testcase& tc = TESTCASES[i];
+        const size_t len = strlen(tc.test_string);
+
+        char* expect_endptr;
+        const double expect_value = new_strtod(tc.test_string, &expect_endptr);
+        const bool expect_failed = expect_endptr != tc.test_string + len;
+
+        bool bad = false;
+        for (size_t split = 0; split <= len && !bad; ++split) {
+            StreamingResult result { 0, 0.0, false };
+            StreamingStrtod stream { "", collect_streaming_result, &result };
+            stream.feed(tc.test_string, split);
+            stream.feed(tc.test_string + split, len - split);
+            stream.finish();
+
+            if (len == 0) {
+                // Empty fields are skipped entirely.
+                bad = result.count != 0;
+                continue;
+            }
+            bad = result.count != 1
+                || result.failed != expect_failed
+                || memcmp(&result.value, &expect_value, sizeof(double)) != 0;
+            if (bad) {
+                printf("%3zu(%-5s): %sFAIL%s at split %zu – %s\n", i, tc.test_name, TEXT_WRONG, TEXT_RESET, split, tc.test_string);
+            }
+        }
+        failed_tests += bad;
+    }
+    printf("Out of %zu streaming tests, %d failed.\n", NUM_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+struct PipeResult {
+    std::vector<double> values;
+    size_t num_failed;
 };
 
-constexpr size_t NUM_TESTCASES = sizeof(TESTCASES) / sizeof(TESTCASES[0]);
+void collect_pipe_result(void* context, double value, bool failed) {
+    PipeResult* result = static_cast<PipeResult*>(context);
+    result->values.push_back(value);
+    result->num_failed += failed;
+}
 
-typedef double (*strtod_fn_t)(const char* str, char** endptr);
+// Writes `contents` into a pipe in pieces of `chunk_size` bytes, from another
+// thread, and checks that `new_strtod_fd` agrees with `new_strtod_batch`.
+bool check_pipe_parse(const char* contents, size_t length, const char* delimiters, size_t chunk_size) {
+    int fds[2];
+    const bool piped = pipe(fds) == 0;
+    assert(piped);
+    (void)piped;
+    std::thread writer([&]() {
+        for (size_t offset = 0; offset < length; offset += chunk_size) {
+            const size_t size = (length - offset < chunk_size) ? length - offset : chunk_size;
+            const bool written = write(fds[1], contents + offset, size) == static_cast<ssize_t>(size);
+            assert(written);
+            (void)written;
+        }
+        close(fds[1]);
+    });
+    PipeResult actual { {}, 0 };
+    const bool ok = new_strtod_fd(fds[0], delimiters, collect_pipe_result, &actual);
+    writer.join();
+    close(fds[0]);
+    if (!ok)
+        return false;
 
-bool evaluate_strtod(strtod_fn_t strtod_fn, const char* test_string, const char* expect_hex, int expect_consume, long long expect_ll) {
-    union readable_t {
-        double as_double;
-        unsigned char as_bytes[8];
+    const size_t max_values = length / 2 + 1;
+    std::vector<double> expect_values(max_values);
+    std::vector<unsigned char> failures(max_values / 8 + 1);
+    const size_t expect_count = new_strtod_batch(contents, delimiters, expect_values.data(), max_values, failures.data(), nullptr);
+    size_t expect_failed = 0;
+    for (size_t i = 0; i < expect_count; ++i)
+        expect_failed += (failures[i / 8] >> (i % 8)) & 1;
+
+    bool good = actual.values.size() == expect_count && actual.num_failed == expect_failed;
+    for (size_t i = 0; good && i < expect_count; ++i)
+        good = memcmp(&actual.values[i], &expect_values[i], sizeof(double)) == 0;
+    return good;
+}
+
+int run_pipe_testcases() {
+    // Much more than fits into the ring at once, so the reader has to wait, too.
+    const size_t num_numbers = 50000;
+    char* contents = static_cast<char*>(malloc(num_numbers * 32 + 1));
+    size_t length = 0;
+    uint32_t state = 54321;
+    for (size_t i = 0; i < num_numbers; ++i) {
+        state = state * 1103515245 + 12345;
+        const char* separator = (state & 0x100) ? "\n" : "  ";
+        if ((state & 0xFF) == 0) {
+            length += sprintf(contents + length, "x%zu%s", i, separator);
+        } else {
+            length += sprintf(contents + length, "%.17g%s", (state >> 8) * 1.0e-3 - 5000.0, separator);
+        }
+    }
+
+    struct {
+        const char* name;
+        const char* contents;
+        size_t length;
+        const char* delimiters;
+        size_t chunk_size;
+    } pipe_testcases[] = {
+        {"PI01", contents, length, " \n", length},
+        {"PI02", contents, length, " \n", 4096},
+        // Odd sizes, so that numbers get split everywhere:
+        {"PI03", contents, length, " \n", 1237},
+        {"PI04", contents, length, " \n", 65537},
+        {"PI05", "1,2.5,,x,-3e2,0x1p4,inf", 23, ",", 1},
+        {"PI06", "", 0, " \n", 1},
+        {"PI07", "12345678901234567890123", 23, " \n", 5},
+        // Digits as delimiters must split fields even in the eight-digit fast path:
+        {"PI08", "123456789012345678909876543210", 30, "5", 30},
+        {"PI09", contents, length, " \n0", 4096},
     };
-    typedef char assert_double_8bytes[sizeof(double) == 8 ? 1 : -1];
-    (void)sizeof(assert_double_8bytes);
-    typedef char assert_readable_8bytes[sizeof(readable_t) == 8 ? 1 : -1];
-    (void)sizeof(assert_readable_8bytes);
-    readable_t readable;
-    char* endptr = (char*)0x123;
+    const size_t num_pipe_testcases = sizeof(pipe_testcases) / sizeof(pipe_testcases[0]);
 
-    readable.as_double = strtod_fn(test_string, &endptr);
+    printf("Running %zu pipe testcases...\n", num_pipe_testcases + 1);
+    int failed_tests = 0;
+    for (size_t i = 0; i < num_pipe_testcases; i++) {
+        const bool good = check_pipe_parse(pipe_testcases[i].contents, pipe_testcases[i].length,
+                                           pipe_testcases[i].delimiters, pipe_testcases[i].chunk_size);
+        printf("%3zu(%-5s): %s%s%s – %zu bytes, in pieces of %zu\n", i, pipe_testcases[i].name,
+               good ? "" : TEXT_WRONG, good ? "good" : "FAIL", good ? "" : TEXT_RESET,
+               pipe_testcases[i].length, pipe_testcases[i].chunk_size);
+        failed_tests += !good;
+    }
 
-    char actual_hex[16 + 1] = {0};
-    for (size_t i = 0; i < 8; ++i) {
-        // Little endian, need to reverse order. Ugh.
-        snprintf(&actual_hex[2 * i], 3, "%02x", readable.as_bytes[8 - 1 - i]);
+    // Read errors must come back as such.
+    PipeResult result { {}, 0 };
+    errno = 0;
+    const bool bad = new_strtod_fd(-1, " \n", collect_pipe_result, &result) || errno != EBADF || !result.values.empty();
+    printf("%3zu(%-5s): %s%s%s – bad file descriptor\n", num_pipe_testcases, "PI10",
+           bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "");
+    failed_tests += bad;
+
+    free(contents);
+    printf("Out of %zu pipe tests, %d failed.\n", num_pipe_testcases + 1, failed_tests);
+    return failed_tests;
+}
+
+// Renders a `CsvTable` compactly, like "name=i:1,!0|x=t:abc": One entry per
+// column, with the type ('i', 'd', or 't'), and a '!' before invalid values.
+std::string dump_csv_table(const CsvTable& table) {
+    std::string dump;
+    for (const CsvColumn& column : table.columns) {
+        if (!dump.empty())
+            dump += '|';
+        dump.append(column.name.first, column.name.last);
+        dump += column.type == CsvColumnType::Int64 ? "=i:" : column.type == CsvColumnType::Double ? "=d:" : "=t:";
+        for (size_t row = 0; row < table.num_rows; ++row) {
+            if (row > 0)
+                dump += ',';
+            if ((column.invalid[row / 8] >> (row % 8)) & 1)
+                dump += '!';
+            char buffer[32];
+            switch (column.type) {
+            case CsvColumnType::Int64:
+                snprintf(buffer, sizeof(buffer), "%lld", column.ints[row]);
+                dump += buffer;
+                break;
+            case CsvColumnType::Double:
+                snprintf(buffer, sizeof(buffer), "%.17g", column.doubles[row]);
+                dump += buffer;
+                break;
+            case CsvColumnType::Text:
+                dump.append(column.texts[row].first, column.texts[row].last);
+                break;
+            default:
+                assert(false); // ASSERT_NOT_REACHED();
+            }
+        }
     }
+    return dump;
+}
 
-    bool actual_consume_possible = false;
-    int actual_consume;
+struct CsvTestcase {
+    const char* test_name;
+    char delimiter;
+    bool has_header;
+    const char* contents;
+    const char* expect;
+};
 
-    if (endptr < test_string) {
-        actual_consume = 999;
-    } else {
-        const char* max_endptr = test_string + serenity_strlen(test_string);
-        actual_consume_possible = endptr <= max_endptr;
-        actual_consume = endptr - test_string;
+static CsvTestcase CSV_TESTCASES[] = {
+    {"V01", ',', true, "a,b,c\n1,2.5,x\n-3,1e3,y\n", "a=i:1,-3|b=d:2.5,1000|c=t:x,y"},
+    {"V02", ';', false, "1;2\n3;4", "=i:1,3|=i:2,4"},
+    {"V03", ',', true, "x,y\r\n1,2\r\n\r\n\n3,4\r\n", "x=i:1,3|y=i:2,4"},
+    // Missing, surplus, and empty fields:
+    {"V04", ',', true, "a,b\n1,2,3\n4\n,5\n", "a=i:1,4,!0|b=i:2,!0,5"},
+    {"V05", ',', true, "n,v\n\"x,\"\"y\"\"\",1\n\"multi\nline\",2\n", "n=t:x,\"\"y\"\",multi\nline|v=i:1,2"},
+    // Doesn't fit into an int64, so it's a double column:
+    {"V06", ',', true, "a\n9223372036854775807\n9223372036854775808\n", "a=d:9.2233720368547758e+18,9.2233720368547758e+18"},
+    // Whitespace around numbers, even with a whitespace delimiter:
+    {"V07", '\t', true, "a\t b\n 1 \t 2 \n\t3\n", "a=i:1,!0| b=i:2,3"},
+    {"V08", ',', true, "a\n0x10\ninf\n", "a=d:16,inf"},
+    {"V09", ',', true, "a,b\n,1\n ,2\n", "a=d:!0,!0|b=i:1,2"},
+    {"V10", ',', true, "a,b\n1x,\"2\"\n", "a=t:1x|b=t:2"},
+    {"V11", ',', true, "", ""},
+    {"V12", ',', false, "\n\n", ""},
+    {"V13", ',', true, "a,b\n", "a=d:|b=d:"},
+    // Delimiters that are also number syntax end the number:
+    {"V14", 'e', false, "1e2\n3e4\n", "=i:1,3|=i:2,4"},
+    {"V15", '.', false, "1.5\n-2.25\n", "=i:1,-2|=i:5,25"},
+    {"V16", '-', false, "1e-5\n2-3\n", "=t:1e,2|=i:5,3"},
+};
+
+constexpr size_t NUM_CSV_TESTCASES = sizeof(CSV_TESTCASES) / sizeof(CSV_TESTCASES[0]);
+
+int run_csv_testcases() {
+    printf("Running %zu CSV testcases...\n", NUM_CSV_TESTCASES + 1);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_CSV_TESTCASES; i++) {
+        const CsvTestcase& tc = CSV_TESTCASES[i];
+        CsvTable table;
+        new_csv_load(tc.contents, tc.contents + strlen(tc.contents), tc.delimiter, tc.has_header, &table);
+        const std::string actual = dump_csv_table(table);
+        const bool bad = actual != tc.expect;
+        printf("%3zu(%-5s): %s%s%s – %s\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "", actual.c_str());
+        failed_tests += bad;
     }
 
-    long long actual_ll = *(unsigned long long*)&readable.as_double;
-    long long off_by = expect_ll - actual_ll;
+    // Only the first rows decide the type. Later misfits are invalid, not promoted.
+    std::string contents = "n,x\n";
+    for (size_t row = 0; row < CSV_SAMPLE_ROWS; ++row)
+        contents += std::to_string(row) + ",1\n";
+    contents += "1.5,2.5\n";
+    CsvTable table;
+    new_csv_load(contents.data(), contents.data() + contents.size(), ',', true, &table);
+    const CsvColumn& n = table.columns[0];
+    const CsvColumn& x = table.columns[1];
+    const bool bad = table.num_rows != CSV_SAMPLE_ROWS + 1 || n.type != CsvColumnType::Int64 || x.type != CsvColumnType::Int64
+        || n.num_invalid != 1 || n.ints[CSV_SAMPLE_ROWS - 1] != static_cast<long long>(CSV_SAMPLE_ROWS - 1)
+        || n.ints[CSV_SAMPLE_ROWS] != 0 || !((n.invalid[CSV_SAMPLE_ROWS / 8] >> (CSV_SAMPLE_ROWS % 8)) & 1)
+        || x.num_invalid != 1;
+    printf("%3zu(%-5s): %s%s%s – %zu rows, late misfits\n", NUM_CSV_TESTCASES, "V17",
+           bad ? TEXT_WRONG : "", bad ? "FAIL" : "good", bad ? TEXT_RESET : "", table.num_rows);
+    failed_tests += bad;
 
-    bool ofby1_hex = off_by != 0 && -8 <= off_by && off_by <= 8;
-    bool wrong_hex = !ofby1_hex && strcmp(expect_hex, actual_hex) != 0;
-    bool error_cns = !actual_consume_possible;
-    bool wrong_cns = !error_cns && (actual_consume != expect_consume);
+    printf("Out of %zu CSV tests, %d failed.\n", NUM_CSV_TESTCASES + 1, failed_tests);
+    return failed_tests;
+}
 
-    printf(" %s%s%s(%s%2u%s)",
-           ofby1_hex ? TEXT_OFBY1 : wrong_hex ? TEXT_WRONG : "",
-           actual_hex,
-           (ofby1_hex || wrong_hex) ? TEXT_RESET : "",
-           error_cns ? TEXT_ERROR : wrong_cns ? TEXT_WRONG : "",
-           actual_consume,
-           (error_cns || wrong_cns) ? TEXT_RESET : "");
+struct FormatTestcase {
+    const char* test_name;
+    const char* hex;
+    const char* expect;
+};
 
-    return wrong_hex || error_cns || wrong_cns;
+static FormatTestcase FORMAT_TESTCASES[] = {
+    {"D01", "3fb999999999999a", "0.1"},
+    {"D02", "3ff0000000000000", "1"},
+    {"D03", "4059000000000000", "100"},
+    {"D04", "408f400000000000", "1e3"},
+    {"D05", "3f50624dd2f1a9fc", "1e-3"},
+    {"D06", "40fe240000000000", "123456"},
+    {"D07", "3fd3333333333333", "0.3"},
+    {"D08", "3efa36e2eb1c432d", "2.5e-5"},
+    {"D09", "8000000000000000", "-0"},
+    {"D10", "0000000000000001", "5e-324"},
+    {"D11", "7fefffffffffffff", "1.7976931348623157e308"},
+    {"D12", "0010000000000000", "2.2250738585072014e-308"},
+    {"D13", "44b52d02c7e14af6", "1e23"},
+    {"D14", "7ff0000000000000", "inf"},
+    {"D15", "fff0000000000000", "-inf"},
+    {"D16", "7ff8000000000000", "nan"},
+    {"D17", "c00921fb54442d18", "-3.141592653589793"},
+    {"D18", "3ff0000000000001", "1.0000000000000002"},
+    // At a power of two, the gap to the next smaller double is only half as large:
+    {"D19", "0020000000000000", "4.450147717014403e-308"},
+    {"D20", "44ea784379d99db4", "1e24"},
+};
+
+constexpr size_t NUM_FORMAT_TESTCASES = sizeof(FORMAT_TESTCASES) / sizeof(FORMAT_TESTCASES[0]);
+
+// The shortest string for `value` must come back as exactly `value`, and
+// no string with fewer significant digits may do that.
+bool check_round_trip(double value) {
+    char buffer[DTOA_BUFFER_SIZE];
+    const int length = new_dtoa(value, buffer);
+    if (length != static_cast<int>(strlen(buffer)))
+        return false;
+
+    char* endptr;
+    const double parsed = new_strtod(buffer, &endptr);
+    if (endptr != buffer + length)
+        return false;
+    if (isnan(value))
+        return isnan(parsed) && signbit(parsed) == signbit(value);
+    if (memcmp(&parsed, &value, sizeof(double)) != 0)
+        return false;
+    if (value == 0 || isinf(value))
+        return true;
+
+    // From the first to the last nonzero digit, so "0.0012" and "1200" both have two.
+    int significant_digits = 0;
+    int seen_digits = 0;
+    for (const char* ptr = buffer; *ptr && *ptr != 'e'; ++ptr) {
+        if (*ptr < '0' || *ptr > '9' || (seen_digits == 0 && *ptr == '0'))
+            continue;
+        seen_digits += 1;
+        if (*ptr != '0')
+            significant_digits = seen_digits;
+    }
+    if (significant_digits > 1) {
+        char shorter[32];
+        snprintf(shorter, sizeof(shorter), "%.*e", significant_digits - 2, value);
+        if (new_strtod(shorter, nullptr) == value)
+            return false;
+    }
+    return true;
 }
 
-long long hex_to_ll(const char* hex) {
-    long long result = 0;
-    for (int i = 0; i < 16; ++i) {
-        char ch = *(hex + i);
-        int digit;
-        if ('0' <= ch && ch <= '9') {
-            digit = ch - '0';
-        } else if ('a' <= ch && ch <= 'f') {
-            digit = ch - 'a' + 10;
-        } else {
-            printf("\n!!! Encountered char %02x at %d.\n", ch, i);
-            assert(false);
+static const int FORMAT_RANDOM_DOUBLES = 100000;
+
+int run_format_testcases() {
+    printf("Running %zu format testcases...\n", NUM_FORMAT_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_FORMAT_TESTCASES; i++) {
+        const FormatTestcase& tc = FORMAT_TESTCASES[i];
+        const long long bits = hex_to_ll(tc.hex);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        char buffer[DTOA_BUFFER_SIZE];
+        new_dtoa(value, buffer);
+        const bool bad = strcmp(buffer, tc.expect) != 0 || !check_round_trip(value);
+        if (bad) {
+            printf("%3zu(%-5s): %sFAIL%s – expected %s, got %s\n", i, tc.test_name, TEXT_WRONG, TEXT_RESET, tc.expect, buffer);
         }
-        result <<= 4;
-        result += digit;
+        failed_tests += bad;
     }
-    return result;
+    printf("Out of %zu format tests, %d failed.\n", NUM_FORMAT_TESTCASES, failed_tests);
+
+    // Every value from the main table, and then a bunch of random bit patterns.
+    printf("Running %zu + %d round-trip testcases...\n", NUM_TESTCASES, FORMAT_RANDOM_DOUBLES);
+    int failed_round_trips = 0;
+    for (size_t i = 0; i < NUM_TESTCASES; i++) {
+        const Testcase& tc = TESTCASES[i];
+        const long long bits = hex_to_ll(tc.hex);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        const bool bad = !check_round_trip(value);
+        if (bad) {
+            printf("%3zu(%-5s): %sFAIL%s – %s\n", i, tc.test_name, TEXT_WRONG, TEXT_RESET, tc.hex);
+        }
+        failed_round_trips += bad;
+    }
+    // xorshift64, so that every run sees the same doubles.
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (int i = 0; i < FORMAT_RANDOM_DOUBLES; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double value;
+        memcpy(&value, &state, sizeof(value));
+        const bool bad = !check_round_trip(value);
+        if (bad) {
+            printf("%5d(rand ): %sFAIL%s – %016llx\n", i, TEXT_WRONG, TEXT_RESET, static_cast<unsigned long long>(state));
+        }
+        failed_round_trips += bad;
+    }
+    printf("Out of %zu round-trip tests, %d failed.\n", NUM_TESTCASES + FORMAT_RANDOM_DOUBLES, failed_round_trips);
+    return failed_tests + failed_round_trips;
 }
 
-int main()
-{
-    if (sizeof(size_t) != 4) {
-        printf("lolwut?!\n");
+// Benchmarks.
+// Each dataset is a bunch of NUL-terminated strings, back to back in one buffer.
+// Every parser gets one pass to warm up, and is then timed over several repetitions.
+
+static const size_t BENCH_NUMBERS_PER_DATASET = 100000;
+static const int BENCH_REPETITIONS = 10;
+
+enum BenchKind {
+    Uniform,
+    ShortIntegers,
+    LongDigits,
+    ExtremeExponents,
+    HexFloats,
+    Repetitive,
+};
+
+struct BenchDataset {
+    const char* name;
+    char* buffer;
+    const char** strings;
+    size_t num_strings;
+    size_t num_bytes;
+};
+
+uint64_t bench_random(uint64_t* state) {
+    // splitmix64, so that every run sees the same data.
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double bench_random_double(uint64_t* state, BenchKind kind) {
+    uint64_t bits = bench_random(state);
+    switch (kind) {
+    case BenchKind::Uniform:
+        // In [0, 1), like most generated data.
+        return (bits >> 11) * 0x1.0p-53;
+    case BenchKind::ShortIntegers:
+        return static_cast<double>(bits % 100000);
+    case BenchKind::Repetitive: {
+        // The same few short tokens over and over, like in logs.
+        static const double COMMON_VALUES[] = { 0, 1, -1, 0.5, 2, 10, 100, 0.25, 1.5, 1000, -0.5, 3 };
+        return COMMON_VALUES[bits % (sizeof(COMMON_VALUES) / sizeof(COMMON_VALUES[0]))];
+    }
+    case BenchKind::ExtremeExponents: {
+        // Biased exponent within 60 of either end, but not INF/NaN.
+        uint64_t biased = bits % 120;
+        biased = (biased < 60) ? (biased + 1) : (0x7FE - (biased - 60));
+        bits = (bits & 0x800FFFFFFFFFFFFFULL) | (biased << 52);
+        break;
+    }
+    default:
+        // Any finite double.
+        if (((bits >> 52) & 0x7FF) == 0x7FF)
+            bits ^= 1ULL << 62;
+        break;
+    }
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+BenchDataset generate_bench_dataset(const char* name, BenchKind kind) {
+    // "%.17g" and "%a" need at most 25 characters, plus the NUL byte.
+    const size_t max_len = 32;
+    BenchDataset dataset;
+    dataset.name = name;
+    dataset.buffer = static_cast<char*>(malloc(BENCH_NUMBERS_PER_DATASET * max_len));
+    dataset.strings = static_cast<const char**>(malloc(BENCH_NUMBERS_PER_DATASET * sizeof(const char*)));
+    dataset.num_strings = BENCH_NUMBERS_PER_DATASET;
+    dataset.num_bytes = 0;
+
+    uint64_t state = kind;
+    char* ptr = dataset.buffer;
+    for (size_t i = 0; i < BENCH_NUMBERS_PER_DATASET; ++i) {
+        const double value = bench_random_double(&state, kind);
+        int len;
+        switch (kind) {
+        case BenchKind::ShortIntegers:
+            len = snprintf(ptr, max_len, "%.0f", value);
+            break;
+        case BenchKind::ExtremeExponents:
+            len = snprintf(ptr, max_len, "%.9e", value);
+            break;
+        case BenchKind::HexFloats:
+            len = snprintf(ptr, max_len, "%a", value);
+            break;
+        default:
+            len = snprintf(ptr, max_len, "%.17g", value);
+            break;
+        }
+        assert(len > 0 && static_cast<size_t>(len) < max_len);
+        dataset.strings[i] = ptr;
+        dataset.num_bytes += len;
+        ptr += len + 1;
+    }
+    return dataset;
+}
+
+void free_bench_dataset(BenchDataset& dataset) {
+    free(dataset.buffer);
+    free(dataset.strings);
+}
+
+double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Keeps the compiler from optimizing the parsing away.
+static volatile uint64_t BENCH_SINK;
+
+double time_strtod_pass(strtod_fn_t strtod_fn, const BenchDataset& dataset) {
+    uint64_t checksum = 0;
+    const double start = now_seconds();
+    for (size_t i = 0; i < dataset.num_strings; ++i) {
+        char* endptr;
+        const double value = strtod_fn(dataset.strings[i], &endptr);
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        checksum += bits ^ reinterpret_cast<uintptr_t>(endptr);
+    }
+    const double elapsed = now_seconds() - start;
+    BENCH_SINK = BENCH_SINK + checksum;
+    return elapsed;
+}
+
+int compare_doubles(const void* a, const void* b) {
+    const double lhs = *static_cast<const double*>(a);
+    const double rhs = *static_cast<const double*>(b);
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+void report_benchmark(const char* fn_name, const BenchDataset& dataset, double* times) {
+    double sum = 0.0;
+    for (int i = 0; i < BENCH_REPETITIONS; ++i)
+        sum += times[i];
+    qsort(times, BENCH_REPETITIONS, sizeof(double), compare_doubles);
+    const double mean = sum / BENCH_REPETITIONS;
+    double variance = 0.0;
+    for (int i = 0; i < BENCH_REPETITIONS; ++i)
+        variance += (times[i] - mean) * (times[i] - mean);
+    const double stddev = sqrt(variance / BENCH_REPETITIONS);
+    const double median = times[BENCH_REPETITIONS / 2];
+
+    printf("%-10s %-12s %10.1f %12.2f %12.2f %12.2f %9.1f%%\n",
+           dataset.name, fn_name,
+           dataset.num_bytes / median / 1e6,
+           median * 1e9 / dataset.num_strings,
+           times[0] * 1e9 / dataset.num_strings,
+           times[BENCH_REPETITIONS - 1] * 1e9 / dataset.num_strings,
+           100.0 * stddev / mean);
+}
+
+void run_benchmark(const char* fn_name, strtod_fn_t strtod_fn, const BenchDataset& dataset) {
+    time_strtod_pass(strtod_fn, dataset);
+
+    double times[BENCH_REPETITIONS];
+    for (int i = 0; i < BENCH_REPETITIONS; ++i)
+        times[i] = time_strtod_pass(strtod_fn, dataset);
+    report_benchmark(fn_name, dataset, times);
+}
+
+double time_batch_pass(const char* joined, double* values, size_t num_strings) {
+    const double start = now_seconds();
+    const size_t count = new_strtod_batch(joined, "\n", values, num_strings, nullptr, nullptr);
+    const double elapsed = now_seconds() - start;
+    assert(count == num_strings);
+    uint64_t bits;
+    memcpy(&bits, &values[count / 2], sizeof(bits));
+    BENCH_SINK = BENCH_SINK + bits;
+    return elapsed;
+}
+
+// `new_strtod_batch` over the whole dataset, one number per line, with `kernel`.
+void run_batch_benchmark(StrtodKernel kernel, const BenchDataset& dataset) {
+    const size_t joined_length = dataset.num_bytes + dataset.num_strings;
+    char* joined = static_cast<char*>(malloc(joined_length + 1));
+    for (size_t i = 0; i < joined_length; ++i)
+        joined[i] = dataset.buffer[i] ? dataset.buffer[i] : '\n';
+    joined[joined_length] = '\0';
+    double* values = static_cast<double*>(malloc(dataset.num_strings * sizeof(double)));
+
+    const StrtodKernel previous_kernel = new_strtod_active_kernel();
+    new_strtod_force_kernel(kernel);
+    time_batch_pass(joined, values, dataset.num_strings);
+    double times[BENCH_REPETITIONS];
+    for (int i = 0; i < BENCH_REPETITIONS; ++i)
+        times[i] = time_batch_pass(joined, values, dataset.num_strings);
+    new_strtod_force_kernel(previous_kernel);
+
+    char fn_name[32];
+    snprintf(fn_name, sizeof(fn_name), "batch/%s", STRTOD_KERNEL_NAMES[kernel]);
+    report_benchmark(fn_name, dataset, times);
+    free(values);
+    free(joined);
+}
+
+int run_benchmarks() {
+    BenchDataset datasets[] = {
+        generate_bench_dataset("uniform", BenchKind::Uniform),
+        generate_bench_dataset("integers", BenchKind::ShortIntegers),
+        generate_bench_dataset("long17", BenchKind::LongDigits),
+        generate_bench_dataset("extreme", BenchKind::ExtremeExponents),
+        generate_bench_dataset("hex", BenchKind::HexFloats),
+        generate_bench_dataset("repeats", BenchKind::Repetitive),
+    };
+
+    printf("Benchmarking %zu numbers per dataset, median of %d repetitions.\n", BENCH_NUMBERS_PER_DATASET, BENCH_REPETITIONS);
+    printf("%-10s %-12s %10s %12s %12s %12s %10s\n", "dataset", "function", "MB/s", "ns/number", "min", "max", "stddev");
+    for (BenchDataset& dataset : datasets) {
+        run_benchmark("builtin", strtod, dataset);
+        run_benchmark("old_strtod", old_strtod, dataset);
+        run_benchmark("new_strtod", new_strtod, dataset);
+        run_benchmark("new/compact", policy_strtod<CompactStrtodPolicy>, dataset);
+        // Hex floats aren't JSON, the parser would just stop after the "0".
+        if (strcmp(dataset.name, "hex") != 0)
+            run_benchmark("new/json", new_strtod_json, dataset);
+        new_strtod_reset_cache();
+        run_benchmark("new/cached", new_strtod_cached, dataset);
+        for (int k = 0; k < NUM_STRTOD_KERNELS; ++k) {
+            if (strtod_kernel_supported(static_cast<StrtodKernel>(k)))
+                run_batch_benchmark(static_cast<StrtodKernel>(k), dataset);
+        }
+        free_bench_dataset(dataset);
+    }
+    return 0;
+}
+
+void print_strtod_counters(const StrtodCounters& counters) {
+    uint64_t total = 0;
+    for (int i = 0; i < NUM_STRTOD_PATHS; ++i)
+        total += counters.paths[i];
+    printf("%zu conversions.\n", static_cast<size_t>(total));
+    if (total == 0)
+        return;
+
+    printf("%-12s %12s %7s\n", "path", "count", "share");
+    for (int i = 0; i < NUM_STRTOD_PATHS; ++i)
+        printf("%-12s %12zu %6.2f%%\n", STRTOD_PATH_NAMES[i], static_cast<size_t>(counters.paths[i]), 100.0 * counters.paths[i] / total);
+
+    if (counters.min_exponent > counters.max_exponent)
+        return;
+    printf("%-12s %12s\n", "digits", "count");
+    for (int i = 0; i < STRTOD_DIGIT_BUCKETS; ++i) {
+        if (counters.digits[i] != 0)
+            printf("%10d%s %12zu\n", i, i == STRTOD_DIGIT_BUCKETS - 1 ? "+" : " ", static_cast<size_t>(counters.digits[i]));
+    }
+    printf("%-12s %12s\n", "exponent", "count");
+    for (int i = 0; i < STRTOD_EXPONENT_BUCKETS; ++i)
+        printf("%-12s %12zu\n", STRTOD_EXPONENT_BUCKET_NAMES[i], static_cast<size_t>(counters.exponents[i]));
+    printf("Exponents range from %d to %d.\n", counters.min_exponent, counters.max_exponent);
+}
+
+// Appends a NUL byte, so the result can be parsed directly.
+bool read_whole_file(const char* path, std::vector<char>* contents) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    char chunk[65536];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        contents->insert(contents->end(), chunk, chunk + length);
+    fclose(file);
+    contents->push_back('\0');
+    return true;
+}
+
+// Parses a whole file on this thread (the counters are per thread, after all),
+// and shows which paths its numbers took.
+int run_counters(const char* path, const char* delimiters) {
+    if (!MYSTRTOD_COUNTERS) {
+        fprintf(stderr, "Counters are compiled out, build with -DMYSTRTOD_COUNTERS=1 (see 'make counters').\n");
+        return 1;
+    }
+    std::vector<char> contents;
+    if (!read_whole_file(path, &contents))
+        return 1;
+
+    new_strtod_reset_counters();
+    const char* parse_ptr = contents.data();
+    size_t count = 0;
+    double values[1024];
+    while (true) {
+        char* endptr;
+        const size_t parsed = new_strtod_batch(parse_ptr, delimiters, values, 1024, nullptr, &endptr);
+        count += parsed;
+        parse_ptr = endptr;
+        if (parsed < 1024)
+            break;
+    }
+    printf("Parsed %zu numbers from %s.\n", count, path);
+    print_strtod_counters(new_strtod_counters());
+    return 0;
+}
+
+struct StreamSummary {
+    size_t count;
+    size_t num_failed;
+    double sum;
+};
+
+void add_to_summary(void* context, double value, bool failed) {
+    StreamSummary* summary = static_cast<StreamSummary*>(context);
+    summary->count += 1;
+    summary->num_failed += failed;
+    summary->sum += value;
+}
+
+// Loads a CSV file with a header, and shows what the columns turned out to be.
+int run_csv(const char* path, char delimiter) {
+    std::vector<char> contents;
+    if (!read_whole_file(path, &contents))
+        return 1;
+    CsvTable table;
+    const double start = now_seconds();
+    new_csv_load(contents.data(), contents.data() + contents.size() - 1, delimiter, true, &table);
+    const double elapsed = now_seconds() - start;
+    printf("Loaded %zu rows and %zu columns in %.3f s (%.1f MB/s).\n", table.num_rows, table.columns.size(),
+           elapsed, (contents.size() - 1) / elapsed * 1e-6);
+    for (const CsvColumn& column : table.columns) {
+        const std::string name(column.name.first, column.name.last);
+        const char* type = column.type == CsvColumnType::Int64 ? "int64" : column.type == CsvColumnType::Double ? "double" : "text";
+        printf("%-20s %-6s %zu invalid\n", name.c_str(), type, column.num_invalid);
+    }
+    return 0;
+}
+
+// E.g. "zcat numbers.gz | ./mystrtod stream".
+int run_stream(const char* delimiters) {
+    StreamSummary summary { 0, 0, 0.0 };
+    const double start = now_seconds();
+    if (!new_strtod_fd(STDIN_FILENO, delimiters, add_to_summary, &summary)) {
+        perror("read");
         return 1;
     }
-    printf("Running %u testcases...\n", NUM_TESTCASES);
-    printf("%3s(%-5s): %16s(%2s) %16s(%2s) %16s(%2s) %16s(%2s) – %s\n", "num", "name", "correct", "cs", "builtin", "cs", "old_strtod", "cs", "new_strtod", "cs", "teststring");
+    const double elapsed = now_seconds() - start;
+    printf("Parsed %zu numbers (%zu failed) in %.3f s, their sum is %.17g.\n", summary.count, summary.num_failed, elapsed, summary.sum);
+    return 0;
+}
+
+// Per-testcase timing, so that pathological inputs stand out in the main table.
+// Each call is repeated until the batch takes long enough to measure, and the
+// fastest of a few batches wins (the others probably got interrupted).
+
+static const double TESTCASE_TIMING_MIN_SECONDS = 0.0005;
+static const int TESTCASE_TIMING_BATCHES = 3;
+static const unsigned TESTCASE_TIMING_MAX_CALLS = 1 << 20;
+// new_strtod is "slow" if it takes this many times as long as the builtin,
+// and the difference is large enough to not just be noise.
+static const double TESTCASE_SLOW_FACTOR = 10.0;
+static const double TESTCASE_SLOW_MIN_NS = 200.0;
+
+double time_testcase_ns(strtod_fn_t strtod_fn, const char* test_string) {
+    double best = INFINITY;
+    for (int batch = 0; batch < TESTCASE_TIMING_BATCHES; ++batch) {
+        unsigned calls = 1;
+        while (true) {
+            uint64_t checksum = 0;
+            const double start = now_seconds();
+            for (unsigned i = 0; i < calls; ++i) {
+                char* endptr;
+                const double value = strtod_fn(test_string, &endptr);
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                checksum += bits ^ reinterpret_cast<uintptr_t>(endptr);
+            }
+            const double elapsed = now_seconds() - start;
+            BENCH_SINK = BENCH_SINK + checksum;
+            if (elapsed >= TESTCASE_TIMING_MIN_SECONDS || calls >= TESTCASE_TIMING_MAX_CALLS) {
+                if (elapsed * 1e9 / calls < best)
+                    best = elapsed * 1e9 / calls;
+                break;
+            }
+            calls *= 2;
+        }
+    }
+    return best;
+}
+
+bool is_slow_testcase(double builtin_ns, double new_ns) {
+    return new_ns > TESTCASE_SLOW_FACTOR * builtin_ns && new_ns - builtin_ns > TESTCASE_SLOW_MIN_NS;
+}
+
+// `./mystrtod perf`: Hardware counters per input category, to see *why* a
+// category is slow (branch misses? cache misses? just more instructions?).
+// They come from perf_event_open, which isn't always allowed (containers,
+// perf_event_paranoid, VMs without a PMU). Then there's only the timer.
+enum PerfCounter {
+    PerfCycles,
+    PerfInstructions,
+    PerfBranchMisses,
+    PerfCacheMisses,
+};
+
+static const int NUM_PERF_COUNTERS = 4;
+static const char* PERF_COUNTER_NAMES[NUM_PERF_COUNTERS] = { "cycles", "instrs", "br-miss", "cache-miss" };
+static const double PERF_MIN_SECONDS = 0.05;
+
+struct PerfCounters {
+    // -1 where the counter isn't available.
+    int fds[NUM_PERF_COUNTERS];
+};
+
+// Opens whatever counters we may have, and returns how many that are.
+int open_perf_counters(PerfCounters* counters) {
+    int num_open = 0;
+    for (int i = 0; i < NUM_PERF_COUNTERS; ++i) {
+        counters->fds[i] = -1;
+#ifdef __linux__
+        static const uint64_t CONFIGS[NUM_PERF_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+        };
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = CONFIGS[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // This thread, any CPU, no group.
+        const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        counters->fds[i] = static_cast<int>(fd);
+        num_open += fd >= 0;
+#endif
+    }
+    return num_open;
+}
+
+void close_perf_counters(PerfCounters* counters) {
+    for (int& fd : counters->fds) {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+}
+
+void start_perf_counters(const PerfCounters& counters) {
+#ifdef __linux__
+    for (int fd : counters.fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    (void)counters;
+#endif
+}
+
+// Unavailable counters read as NAN.
+void stop_perf_counters(const PerfCounters& counters, double* values) {
+    for (int i = 0; i < NUM_PERF_COUNTERS; ++i) {
+        values[i] = NAN;
+#ifdef __linux__
+        const int fd = counters.fds[i];
+        uint64_t value;
+        if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(fd, &value, sizeof(value)) == sizeof(value))
+            values[i] = static_cast<double>(value);
+#endif
+    }
+}
+
+// The categories that the testcases fall into, roughly by which path they take.
+enum TestcaseCategory {
+    CategoryPlain,
+    CategorySpecial,
+    CategoryHex,
+    CategoryExponentOverflow,
+    CategoryLongDigits,
+};
+
+static const int NUM_TESTCASE_CATEGORIES = 5;
+static const char* TESTCASE_CATEGORY_NAMES[NUM_TESTCASE_CATEGORIES] = {
+    "plain", "special", "hex", "exponent", "long digits",
+};
+
+// Looks at the text only, so this works without MYSTRTOD_COUNTERS.
+TestcaseCategory categorize_testcase(const char* str) {
+    while (is_space(*str))
+        str += 1;
+    if (*str == '+' || *str == '-')
+        str += 1;
+    if (*str == 'i' || *str == 'I' || *str == 'n' || *str == 'N')
+        return TestcaseCategory::CategorySpecial;
+    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+        return TestcaseCategory::CategoryHex;
+
+    int num_digits = 0;
+    bool leading_zeros = true;
+    for (; digit_value(*str, 10) != -1 || *str == '.'; ++str) {
+        leading_zeros &= *str == '0' || *str == '.';
+        num_digits += !leading_zeros && *str != '.';
+    }
+    if (*str == 'e' || *str == 'E') {
+        str += 1;
+        if (*str == '+' || *str == '-')
+            str += 1;
+        // Beyond what any double can use, no matter how many digits there are.
+        int exponent_digits = 0;
+        while (*str == '0')
+            str += 1;
+        while (digit_value(str[exponent_digits], 10) != -1)
+            exponent_digits += 1;
+        if (exponent_digits > 3)
+            return TestcaseCategory::CategoryExponentOverflow;
+    }
+    return num_digits > 19 ? TestcaseCategory::CategoryLongDigits : TestcaseCategory::CategoryPlain;
+}
+
+// Parses `strings` over and over, until that took long enough, and reports per parse.
+void measure_category(const char* fn_name, strtod_fn_t strtod_fn, const char* category,
+                      const std::vector<const char*>& strings, const PerfCounters& counters) {
+    uint64_t checksum = 0;
+    size_t passes = 0;
+    double values[NUM_PERF_COUNTERS];
+    const double start = now_seconds();
+    start_perf_counters(counters);
+    do {
+        for (const char* str : strings) {
+            char* endptr;
+            const double value = strtod_fn(str, &endptr);
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            checksum += bits ^ reinterpret_cast<uintptr_t>(endptr);
+        }
+        passes += 1;
+    } while (now_seconds() - start < PERF_MIN_SECONDS);
+    stop_perf_counters(counters, values);
+    const double elapsed = now_seconds() - start;
+    BENCH_SINK = BENCH_SINK + checksum;
+
+    const double parses = static_cast<double>(passes) * strings.size();
+    printf("%-12s %-12s %8zu %10.1f", category, fn_name, strings.size(), elapsed * 1e9 / parses);
+    for (int i = 0; i < NUM_PERF_COUNTERS; ++i) {
+        if (isnan(values[i]))
+            printf(" %10s", "-");
+        else
+            printf(" %10.1f", values[i] / parses);
+    }
+    if (isnan(values[PerfCycles]) || isnan(values[PerfInstructions]))
+        printf(" %5s\n", "-");
+    else
+        printf(" %5.2f\n", values[PerfInstructions] / values[PerfCycles]);
+}
+
+int run_perf() {
+    std::vector<const char*> categories[NUM_TESTCASE_CATEGORIES];
+    for (size_t i = 0; i < NUM_TESTCASES; ++i)
+        categories[categorize_testcase(TESTCASES[i].test_string)].push_back(TESTCASES[i].test_string);
+
+    PerfCounters counters;
+    if (open_perf_counters(&counters) == 0)
+        printf("No hardware counters available (try perf_event_paranoid <= 2), timing only.\n");
+    printf("%-12s %-12s %8s %10s", "category", "function", "strings", "ns/parse");
+    for (int i = 0; i < NUM_PERF_COUNTERS; ++i)
+        printf(" %10s", PERF_COUNTER_NAMES[i]);
+    printf(" %5s\n", "IPC");
+    for (int c = 0; c < NUM_TESTCASE_CATEGORIES; ++c) {
+        if (categories[c].empty())
+            continue;
+        measure_category("builtin", strtod, TESTCASE_CATEGORY_NAMES[c], categories[c], counters);
+        measure_category("new_strtod", new_strtod, TESTCASE_CATEGORY_NAMES[c], categories[c], counters);
+    }
+    close_perf_counters(&counters);
+    return 0;
+}
+
+struct CategoryTestcase {
+    const char* test_name;
+    TestcaseCategory category;
+    const char* test_string;
+};
+
+static CategoryTestcase CATEGORY_TESTCASES[] = {
+    {"K01", CategoryPlain, "1.5e3"},
+    {"K02", CategorySpecial, " -Infinity"},
+    {"K03", CategorySpecial, "nan"},
+    {"K04", CategoryHex, "+0x1p-3"},
+    {"K05", CategoryExponentOverflow, "1e-4294967296"},
+    {"K06", CategoryPlain, "1e-0000000308"},
+    {"K07", CategoryLongDigits, "12345678901234567890"},
+    // Leading zeros don't count:
+    {"K08", CategoryPlain, "0.0000000000000000000001"},
+};
+
+constexpr size_t NUM_CATEGORY_TESTCASES = sizeof(CATEGORY_TESTCASES) / sizeof(CATEGORY_TESTCASES[0]);
+
+int run_category_testcases() {
+    printf("Running %zu category testcases...\n", NUM_CATEGORY_TESTCASES);
+    int failed_tests = 0;
+    for (size_t i = 0; i < NUM_CATEGORY_TESTCASES; i++) {
+        const CategoryTestcase& tc = CATEGORY_TESTCASES[i];
+        const TestcaseCategory actual = categorize_testcase(tc.test_string);
+        const bool bad = actual != tc.category;
+        printf("%3zu(%-5s): %s%-12s%s – %s\n", i, tc.test_name,
+               bad ? TEXT_WRONG : "", TESTCASE_CATEGORY_NAMES[actual], bad ? TEXT_RESET : "", tc.test_string);
+        failed_tests += bad;
+    }
+    printf("Out of %zu category tests, %d failed.\n", NUM_CATEGORY_TESTCASES, failed_tests);
+    return failed_tests;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_benchmarks();
+    }
+    if (argc > 1 && strcmp(argv[1], "perf") == 0) {
+        return run_perf();
+    }
+    if (argc > 2 && strcmp(argv[1], "counters") == 0) {
+        return run_counters(argv[2], argc > 3 ? argv[3] : " \t\r\n,;");
+    }
+    if (argc > 2 && strcmp(argv[1], "csv") == 0) {
+        return run_csv(argv[2], argc > 3 ? argv[3][0] : ',');
+    }
+    if (argc > 1 && strcmp(argv[1], "stream") == 0) {
+        return run_stream(argc > 2 ? argv[2] : " \t\r\n,;");
+    }
+    printf("Running %zu testcases...\n", NUM_TESTCASES);
+    printf("%3s(%-5s): %16s(%2s) %16s(%2s) %16s(%2s) %16s(%2s) %9s %9s %9s – %s\n", "num", "name", "correct", "cs", "builtin", "cs", "old_strtod", "cs", "new_strtod", "cs", "ns_bi", "ns_old", "ns_new", "teststring");
 
     int stay_good = 0;
     int stay_bad = 0;
     int regressions = 0;
     int fixes = 0;
+    int slow = 0;
     for (size_t i = 0; i < NUM_TESTCASES; i++)
     {
         Testcase& tc = TESTCASES[i];
         if (tc.should_consume == -1) {
             tc.should_consume = strlen(tc.test_string);
         }
-        printf("%3u(%-5s):", i, tc.test_name);
+        printf("%3zu(%-5s):", i, tc.test_name);
         printf(" %s(%2d)", tc.hex, tc.should_consume);
         long long expect_ll = hex_to_ll(tc.hex);
         evaluate_strtod(strtod, tc.test_string, tc.hex, tc.should_consume, expect_ll);
@@ -833,6 +5587,11 @@ int main()
             old_bad = evaluate_strtod(old_strtod, tc.test_string, tc.hex, tc.should_consume, expect_ll);
         }
         bool new_bad = evaluate_strtod(new_strtod, tc.test_string, tc.hex, tc.should_consume, expect_ll);
+        const double builtin_ns = time_testcase_ns(strtod, tc.test_string);
+        // The skipped ones are exactly those where old_strtod takes forever.
+        const double old_ns = tc.skip_old ? NAN : time_testcase_ns(old_strtod, tc.test_string);
+        const double new_ns = time_testcase_ns(new_strtod, tc.test_string);
+        printf(" %9.1f %9.1f %9.1f", builtin_ns, old_ns, new_ns);
         printf(" – %s", tc.test_string);
         switch ((old_bad ? 2 : 0) | (new_bad ? 1 : 0))
         {
@@ -845,9 +5604,40 @@ int main()
             case 0b11: stay_bad += 1; break;
             default: assert(false);
         }
+        if (is_slow_testcase(builtin_ns, new_ns)) {
+            slow += 1;
+            printf(" %sSLOW%s", TEXT_WRONG, TEXT_RESET);
+        }
         printf("\n");
     }
-    printf("Out of %d tests, the new strtod regresses %d and fixes %d.\n", NUM_TESTCASES, regressions, fixes);
+    printf("Out of %zu tests, the new strtod regresses %d and fixes %d.\n", NUM_TESTCASES, regressions, fixes);
     printf("(%d stayed good and %d stayed bad.)\n", stay_good, stay_bad);
+    printf("The new strtod is more than %.0fx slower than the builtin on %d tests.\n", TESTCASE_SLOW_FACTOR, slow);
+
+    // The bulk functions once with every kernel this CPU has.
+    const StrtodKernel detected_kernel = new_strtod_active_kernel();
+    for (int k = 0; k < NUM_STRTOD_KERNELS; ++k) {
+        if (!new_strtod_force_kernel(static_cast<StrtodKernel>(k)))
+            continue;
+        printf("Using the %s kernel%s.\n", STRTOD_KERNEL_NAMES[k], k == detected_kernel ? " (detected)" : "");
+        run_batch_testcases();
+        run_file_testcases();
+    }
+    new_strtod_force_kernel(detected_kernel);
+    run_kernel_testcases();
+    run_range_testcases();
+    run_streaming_testcases();
+    run_pipe_testcases();
+    run_csv_testcases();
+    run_policy_testcases();
+    run_json_testcases();
+    run_counter_testcases();
+    run_cache_testcases();
+    run_compact_testcases();
+    run_narrow_testcases();
+    run_integer_testcases();
+    run_fixed_testcases();
+    run_format_testcases();
+    run_category_testcases();
     return 0;
 }